@@ -0,0 +1,34 @@
+#include "arena.h"
+
+/* a word array so that every region starts word aligned */
+static uint16_t arena[ARENA_SIZE / 2];
+
+/* the linker script checks the stack that is left against this, an absolute
+ * symbol, so that the minimum is only set in arena.h */
+#define ARENA_STR(x)    #x
+#define ARENA_XSTR(x)   ARENA_STR(x)
+__asm__(".global __ARENA_STACK_BYTES\n"
+        "\t.equ __ARENA_STACK_BYTES, " ARENA_XSTR(ARENA_STACK_BYTES));
+
+static const uint16_t regionBytes[ARENA_NUM_OF_REGIONS] = {
+    ARENA_UART_TX_BYTES,
+    ARENA_UART_RX_BYTES,
+    ARENA_SAMPLES_BYTES,
+    ARENA_FRAME_RX_BYTES,
+    ARENA_MESSAGE_BYTES
+};
+
+void* ARENA_region(ArenaRegion region){
+    uint8_t* start = (uint8_t*)arena;
+    uint16_t i;
+    
+    for(i = 0; i < (uint16_t)region; i++){
+        start += regionBytes[i];
+    }
+    
+    return start;
+}
+
+uint16_t ARENA_regionBytes(ArenaRegion region){
+    return regionBytes[region];
+}
@@ -0,0 +1,92 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stdint.h>
+#include "dispatch_config.h"
+
+/** The RAM profiles, selected using ARENA_PROFILE:
+ *  ARENA_PROFILE_SWEEP  - full resolution sweeps, 128 samples
+ *  ARENA_PROFILE_STREAM - coarser sweeps, 32 samples, trading the sample
+ *                         memory for twice the transmit buffer so that
+ *                         the other topics are throttled less often */
+#define ARENA_PROFILE_SWEEP     0
+#define ARENA_PROFILE_STREAM    1
+
+#define ARENA_PROFILE   ARENA_PROFILE_SWEEP
+
+#if ARENA_PROFILE == ARENA_PROFILE_SWEEP
+#define NUM_OF_SAMPLES      128
+#define TX_BUF_LENGTH       256
+#define RX_BUF_LENGTH       64
+#elif ARENA_PROFILE == ARENA_PROFILE_STREAM
+#define NUM_OF_SAMPLES      32
+#define TX_BUF_LENGTH       512
+#define RX_BUF_LENGTH       64
+#else
+#error "ARENA_PROFILE must be ARENA_PROFILE_SWEEP or ARENA_PROFILE_STREAM"
+#endif
+
+/* the RAM of the device */
+#define ARENA_DEVICE_RAM        2048
+
+/* the least stack for a task with both interrupt levels nested on top; the
+ * statics of the other modules vary with the build, so the fit is checked
+ * at link time: arena.c hands this value to the linker script, which fails
+ * the link if less than this is left for the stack once every section is
+ * placed.  Check it against MEM_STACK_PEAK on "mem" too */
+#define ARENA_STACK_BYTES       256
+
+/* the regions are kept word aligned */
+#define ARENA_ALIGN(bytes)      (((bytes) + 1) & ~1)
+
+#define ARENA_UART_TX_BYTES     ARENA_ALIGN(TX_BUF_LENGTH)
+#define ARENA_UART_RX_BYTES     ARENA_ALIGN(RX_BUF_LENGTH)
+#define ARENA_SAMPLES_BYTES     (NUM_OF_SAMPLES * 4)    /* two int16_t each */
+#define ARENA_FRAME_RX_BYTES    ARENA_ALIGN(RX_FRAME_LENGTH)
+#define ARENA_MESSAGE_BYTES     ARENA_ALIGN(MAX_RECEIVE_MESSAGE_LEN)
+
+#define ARENA_SIZE  (ARENA_UART_TX_BYTES \
+                    + ARENA_UART_RX_BYTES \
+                    + ARENA_SAMPLES_BYTES \
+                    + ARENA_FRAME_RX_BYTES \
+                    + ARENA_MESSAGE_BYTES)
+
+/* only the arena and the stack are known here, the rest is left to the link */
+#if ARENA_SIZE > (ARENA_DEVICE_RAM - ARENA_STACK_BYTES)
+#error "the arena configuration does not fit in the device RAM"
+#endif
+
+#if (NUM_OF_SAMPLES != 16) && \
+    (NUM_OF_SAMPLES != 32) && \
+    (NUM_OF_SAMPLES != 64) && \
+    (NUM_OF_SAMPLES != 128) && \
+    (NUM_OF_SAMPLES != 256)
+#error "NUM_OF_SAMPLES must be a power of 2 between 16 and 256"
+#endif
+
+/** The regions of the arena, each handed to a single module */
+typedef enum arenaregion{
+    ARENA_UART_TX,      /* TX_BUF_LENGTH bytes */
+    ARENA_UART_RX,      /* RX_BUF_LENGTH bytes */
+    ARENA_SAMPLES,      /* the load voltage then the load current samples */
+    ARENA_FRAME_RX,     /* RX_FRAME_LENGTH bytes */
+    ARENA_MESSAGE,      /* MAX_RECEIVE_MESSAGE_LEN bytes */
+    ARENA_NUM_OF_REGIONS
+}ArenaRegion;
+
+/**
+ * Returns the fixed location of a region; the regions are laid out at
+ * compile time, so this never fails, and they start zeroed
+ * 
+ * @param region the ArenaRegion
+ * @return the start of the region
+ */
+void* ARENA_region(ArenaRegion region);
+
+/**
+ * @param region the ArenaRegion
+ * @return the size of the region in bytes
+ */
+uint16_t ARENA_regionBytes(ArenaRegion region);
+
+#endif
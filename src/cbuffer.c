@@ -190,7 +190,15 @@ uint32_t BUF_read32(Buffer* b){
     return readValue;
 }
 
+uint16_t BUF_writeIndex(Buffer* b){
+    return b->newest_index;
+}
 
+uint16_t BUF_readIndex(Buffer* b){
+    return b->oldest_index;
+}
 
-
-
+void BUF_overwrite8(Buffer* b, uint16_t index, uint8_t writeValue){
+    uint8_t* dataBuf = (uint8_t*)b->dataPtr;
+    dataBuf[index & (b->length - 1)] = writeValue;
+}
@@ -31,6 +31,12 @@ uint8_t BUF_read8(Buffer* b);
 uint16_t BUF_read16(Buffer* b);
 uint32_t BUF_read32(Buffer* b);
 
+/* the index of the slot that the next write fills and of the slot that the
+ * next read empties, and a way to change a value already written */
+uint16_t BUF_writeIndex(Buffer* b);
+uint16_t BUF_readIndex(Buffer* b);
+void BUF_overwrite8(Buffer* b, uint16_t index, uint8_t writeValue);
+
 
 
 #endif
@@ -0,0 +1,68 @@
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+/** The clock profiles, selected using CLOCK_PROFILE:
+ *  CLOCK_PROFILE_EC     - the external clock on the primary oscillator,
+ *                         24 MHz, for F_CY = 12 MHz
+ *  CLOCK_PROFILE_FRCPLL - the 8 MHz internal oscillator through the 4x PLL,
+ *                         32 MHz, for F_CY = 16 MHz, the fastest that the
+ *                         part runs; the internal oscillator is only
+ *                         accurate to about 2%, which the UART tolerates */
+#define CLOCK_PROFILE_EC        0
+#define CLOCK_PROFILE_FRCPLL    1
+
+#define CLOCK_PROFILE   CLOCK_PROFILE_EC
+
+#if CLOCK_PROFILE == CLOCK_PROFILE_EC
+#define F_OSC   24000000
+#elif CLOCK_PROFILE == CLOCK_PROFILE_FRCPLL
+#define F_OSC   32000000
+#else
+#error "CLOCK_PROFILE must be CLOCK_PROFILE_EC or CLOCK_PROFILE_FRCPLL"
+#endif
+
+/* the instruction clock is half of the oscillator */
+#define F_CY    (F_OSC / 2)
+
+#if (F_CY % 1000000) != 0
+#error "F_CY must be a whole number of MHz"
+#endif
+
+/* the cycles in each 1 ms task tick, the CCP3 period */
+#define CLOCK_TICK_CYCLES   (F_CY / 1000)
+
+/* the UART runs with the high speed (BRGH) baud clock, F_CY / 4, since
+ * the standard F_CY / 16 clock can't get close enough to the baud rate
+ * at F_CY = 16 MHz */
+#define CLOCK_BAUD_RATE     57600
+#define CLOCK_U1BRG         (((F_CY + (2 * CLOCK_BAUD_RATE)) \
+                                / (4 * CLOCK_BAUD_RATE)) - 1)
+#define CLOCK_ACTUAL_BAUD   (F_CY / (4 * (CLOCK_U1BRG + 1)))
+
+#if ((CLOCK_ACTUAL_BAUD * 100) > (CLOCK_BAUD_RATE * 101)) || \
+    ((CLOCK_ACTUAL_BAUD * 100) < (CLOCK_BAUD_RATE * 99))
+#error "the baud rate is more than 1% from CLOCK_BAUD_RATE at this F_CY"
+#endif
+
+/* the ADC clock is F_CY / (ADCS + 1), kept at or above the minimum Tad */
+#define CLOCK_ADC_TAD_NS    650
+#define CLOCK_ADCS          ((((CLOCK_ADC_TAD_NS * (F_CY / 1000)) + 999999) \
+                                / 1000000) - 1)
+
+#if CLOCK_ADCS > 255
+#error "the ADC clock divider is out of range at this F_CY"
+#endif
+
+/* the host gives the waveform period in cycles of a 12 MHz clock, whatever
+ * the actual F_CY, so that the protocol doesn't depend on the profile; the
+ * timer 1 period is converted from and to those units, rounded */
+#define CLOCK_HOST_PERIOD_HZ    12000000
+
+#define CLOCK_PERIOD_FROM_HOST(p)   ((((uint32_t)(p) * (F_CY / 1000)) \
+                                        + (CLOCK_HOST_PERIOD_HZ / 2000)) \
+                                        / (CLOCK_HOST_PERIOD_HZ / 1000))
+#define CLOCK_PERIOD_TO_HOST(p)     ((((uint32_t)(p) * (CLOCK_HOST_PERIOD_HZ / 1000)) \
+                                        + (F_CY / 2000)) \
+                                        / (F_CY / 1000))
+
+#endif
@@ -4,6 +4,7 @@
 #define	XC_CONFIG_H
 
 #include <xc.h> // include processor files - each processor file is guarded.  
+#include "clock.h"
 
 /********************* CONFIGURATION BIT SETTINGS *****************************/
 // FBS
@@ -15,13 +16,21 @@
 #pragma config GCP = OFF                // General Segment Code Protect (No Protection)
 
 // FOSCSEL
+#if CLOCK_PROFILE == CLOCK_PROFILE_FRCPLL
+#pragma config FNOSC = FRCPLL           // Oscillator Select (Fast RC Oscillator with PLL)
+#else
 #pragma config FNOSC = PRI              // Oscillator Select (Primary Oscillator (XT, HS, EC))
+#endif
 #pragma config SOSCSRC = ANA            // SOSC Source Type (Analog Mode for use with crystal)
 #pragma config LPRCSEL = LP             // LPRC Oscillator Power and Accuracy (Low Power, Low Accuracy Mode)
 #pragma config IESO = ON                // Internal External Switch Over bit (Internal External Switchover mode enabled (Two-speed Start-up enabled))
 
 // FOSC
+#if CLOCK_PROFILE == CLOCK_PROFILE_FRCPLL
+#pragma config POSCMOD = NONE           // Primary Oscillator Configuration bits (Primary oscillator disabled)
+#else
 #pragma config POSCMOD = EC             // Primary Oscillator Configuration bits (External clock mode selected)
+#endif
 #pragma config OSCIOFNC = CLKO          // CLKO Enable Configuration bit (CLKO output signal enabled)
 #pragma config POSCFREQ = HS            // Primary Oscillator Frequency Range Configuration bits (Primary oscillator/external clock input frequency greater than 8MHz)
 #pragma config SOSCSEL = SOSCHP         // SOSC Power Selection Configuration bits (Secondary Oscillator configured for high-power operation)
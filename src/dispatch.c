@@ -1,61 +1,283 @@
 #include "dispatch.h"
 #include "frame.h"
+#include "arena.h"
+#include "task.h"
 
 #include <stdarg.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
 
-typedef enum formatspecifier{
-    eNONE = 0,
-    eSTRING = 1,
-    eU8 = 2,
-    eS8 = 3,
-    eU16 = 4,
-    eS16 = 5,
-    eU32 = 6,
-    eS32 = 7
-}FormatSpecifier;
+/* a frame whose first byte has this bit set carries a one-byte
+ * topic id in place of the topic string */
+#define TOPIC_ID_FLAG       0x80
+
+/* the topic used to request and announce the topic ids */
+#define TOPICS_TOPIC        "topics"
+
+/* each chunk begins with its u16 offset and the u16 total length; the
+ * acknowledgement of a refused transfer */
+#define CHUNK_HEADER_LEN    4
+#define CHUNK_REFUSED       0xffff
+
+#if (MAX_NUM_OF_SUBSCRIPTIONS + MAX_NUM_OF_PUBLISHED_TOPICS) > 128
+#error "too many topics to be identified by a 7-bit topic id"
+#endif
 
 typedef struct{
     uint8_t dimensions;
     uint16_t length;
-    uint32_t length8bit;
+    uint16_t length8bit;
     FormatSpecifier formatSpecifiers[MAX_NUM_OF_FORMAT_SPECIFIERS];
+    uint16_t offsets[MAX_NUM_OF_FORMAT_SPECIFIERS];
     
-    uint8_t data[MAX_RECEIVE_MESSAGE_LEN];
+    /* points into the received frame, the data is never copied */
+    uint8_t* data;
 }Message;
 
 typedef struct {
-    char topic[MAX_TOPIC_STR_LEN];
+    const char* topic;      /* the caller's string, which is never copied */
 	void (*subFunctPtr)();
 }Subscription;
 
+typedef struct {
+    const char* topic;
+    uint16_t txMarker;
+    uint16_t drops;
+    uint8_t pending;
+}Conflation;
+
+typedef struct {
+    const char* topic;
+    uint8_t* dest;
+    uint16_t maxLength;
+    uint16_t total;
+    uint16_t expected;
+    uint16_t ack;
+    uint8_t unacked;
+    uint8_t ackPending;
+    void (*doneFunctPtr)(uint16_t length);
+}ChunkTransfer;
+
+typedef struct {
+    const char* topic;
+    int16_t* data[2];
+    uint16_t length;
+    uint16_t index;
+    int16_t previous;
+    uint8_t dimension;
+    FormatSpecifier format;
+    uint8_t active;
+}SlicedPublish;
+
+typedef struct {
+    uint8_t (*pubFunctPtr)(uint8_t keepalive);
+    uint16_t keepalive;     /* ms */
+    uint32_t lastKeepalive; /* the TASK_getTime() of the last keepalive */
+    uint8_t keepaliveDue;
+    volatile uint8_t changed;
+}Publisher;
+
 /********** global variable declarations **********/
 static Message rxMsg;
+static uint8_t* rxFrameData;
 static Subscription sub[MAX_NUM_OF_SUBSCRIPTIONS];
+static Conflation conflation[MAX_NUM_OF_CONFLATED_TOPICS];
+static Publisher pub[MAX_NUM_OF_PUBLISHERS];
+static ChunkTransfer chunks[MAX_NUM_OF_CHUNKED_TOPICS];
+static const char* rxTopic = 0;
+static SlicedPublish slice;
+static const char* pubTopic[MAX_NUM_OF_PUBLISHED_TOPICS];
+static uint8_t compactTopics = 0;
+static uint8_t announcePending = 0;
+static uint8_t frameDropped = 0;
 
 /********** local function declarations **********/
-uint16_t getCurrentRxPointerIndex(uint8_t element);
-uint16_t parseTopicString(const char* topic, uint8_t dimensions);
+uint16_t parseTopicString(const char* topic, uint8_t dimensions, uint8_t elementBytes);
+static uint16_t parseArrayLength(const char* topic);
+static FormatSpecifier parseFormatSpecifier(const char* topic, uint16_t* strIndex);
+static void pushFormatSpecifiers(FormatSpecifier* formatSpecifiers, uint8_t dimensions);
+static void pushScalar(FormatSpecifier formatSpecifier, void* data);
+static void pushPacked12(uint16_t* data, uint16_t length);
+static void pushDelta16(int16_t* data, uint16_t length);
+static uint16_t pushPacked12Pair(uint16_t* data, uint16_t index, uint16_t length);
+static void pushDelta16Element(int16_t value, int16_t* previous);
+static uint8_t startFrame(const char* topic, uint8_t dimensions, uint32_t dataBytes);
+static uint16_t dimensionBytes(FormatSpecifier formatSpecifier, uint16_t length,
+        uint8_t* data, uint16_t maxBytes);
+static uint16_t readVarint(const uint8_t* data, uint16_t* byteIndex, uint16_t bytes);
+static int32_t readFixedElement(const DispatchView* view, uint16_t index);
+static uint8_t topicMatches(const char* topic0, const char* topic1);
+static Conflation* findConflation(const char* topic);
+static uint8_t publishDrop(const char* topic);
+static void finishFrame(const char* topic);
+static uint16_t pushTopic(const char* topic);
+static uint8_t announceTopics(void);
+static void receiveChunk(void);
+static void sendChunkAck(ChunkTransfer* c, uint16_t ack);
 
 /********** function implementations **********/
 void DIS_init(void){
     uint16_t i = 0;
     
+    /* the receive buffers are regions of the arena */
+    rxFrameData = ARENA_region(ARENA_MESSAGE);
+    FRM_initReceive();
+    
     /* clear the subscriptions */
     for(i = 0; i < MAX_NUM_OF_SUBSCRIPTIONS; i++){
         sub[i].subFunctPtr = 0;
-        sub[i].topic[0] = 0;    // terminate the string
+        sub[i].topic = 0;
+    }
+    
+    /* clear the conflated topics */
+    for(i = 0; i < MAX_NUM_OF_CONFLATED_TOPICS; i++){
+        conflation[i].topic = 0;
+        conflation[i].drops = 0;
+        conflation[i].pending = 0;
+    }
+    
+    /* clear the published topics, the host must ask for
+     * the topic ids before they are used */
+    for(i = 0; i < MAX_NUM_OF_PUBLISHED_TOPICS; i++){
+        pubTopic[i] = 0;
+    }
+    compactTopics = 0;
+    announcePending = 0;
+    
+    /* clear the chunked transfers */
+    for(i = 0; i < MAX_NUM_OF_CHUNKED_TOPICS; i++){
+        chunks[i].topic = 0;
+    }
+    
+    slice.active = 0;
+    
+    /* clear the publishers */
+    for(i = 0; i < MAX_NUM_OF_PUBLISHERS; i++){
+        pub[i].pubFunctPtr = 0;
+        pub[i].changed = 0;
+    }
+}
+
+void DIS_conflate(const char* topic){
+    uint16_t i;
+    
+    if(findConflation(topic) != 0)
+        return;
+    
+    for(i = 0; i < MAX_NUM_OF_CONFLATED_TOPICS; i++){
+        if(conflation[i].topic == 0){
+            conflation[i].topic = topic;
+            conflation[i].drops = 0;
+            conflation[i].pending = 0;
+            
+            break;
+        }
+    }
+}
+
+uint16_t DIS_getDropCount(const char* topic){
+    Conflation* c = findConflation(topic);
+    
+    if(c == 0)
+        return 0;
+    
+    return c->drops;
+}
+
+void DIS_registerTopic(const char* topic){
+    uint16_t i;
+    
+    for(i = 0; i < MAX_NUM_OF_PUBLISHED_TOPICS; i++){
+        if(pubTopic[i] == 0){
+            pubTopic[i] = topic;
+            break;
+        }else if(topicMatches(pubTopic[i], topic)){
+            break;
+        }
+    }
+}
+
+void DIS_schedulePublisher(uint8_t (*functPtr)(uint8_t keepalive), uint16_t keepalive){
+    uint16_t i;
+    
+    for(i = 0; i < MAX_NUM_OF_PUBLISHERS; i++){
+        if((pub[i].pubFunctPtr == functPtr) || (pub[i].pubFunctPtr == 0)){
+            pub[i].pubFunctPtr = functPtr;
+            pub[i].keepalive = keepalive;
+            
+            /* the first pass is always a keepalive so that
+             * everything is sent once at startup */
+            pub[i].keepaliveDue = 1;
+            
+            break;
+        }
+    }
+}
+
+void DIS_notifyChanged(uint8_t (*functPtr)(uint8_t keepalive)){
+    uint16_t i;
+    
+    for(i = 0; i < MAX_NUM_OF_PUBLISHERS; i++){
+        if(pub[i].pubFunctPtr == functPtr){
+            pub[i].changed = 1;
+        }
+    }
+}
+
+void DIS_managePublishers(void){
+    uint32_t now = TASK_getTime();
+    uint16_t i;
+    
+    /* the ids are only used once their announcement is on its way */
+    if(announcePending && (slice.active == 0) && announceTopics()){
+        announcePending = 0;
+        compactTopics = 1;
+    }
+    
+    /* a dropped acknowledgement would leave the host waiting on it */
+    for(i = 0; i < MAX_NUM_OF_CHUNKED_TOPICS; i++){
+        if((chunks[i].topic != 0) && chunks[i].ackPending)
+            chunks[i].ackPending = (DIS_publish_u16(chunks[i].topic, &chunks[i].ack) == 0);
+    }
+    
+    for(i = 0; i < MAX_NUM_OF_PUBLISHERS; i++){
+        if(pub[i].pubFunctPtr == 0)
+            continue;
+        
+        /* the elapsed time is measured, so the rate at which this
+         * is called only affects how late a keepalive may be */
+        if((now - pub[i].lastKeepalive) >= pub[i].keepalive)
+            pub[i].keepaliveDue = 1;
+        
+        if(pub[i].keepaliveDue){
+            pub[i].changed = 0;
+            
+            /* a keepalive that didn't make it out is retried on the next pass */
+            if(pub[i].pubFunctPtr(1)){
+                pub[i].keepaliveDue = 0;
+                pub[i].lastKeepalive = now;
+            }
+        }else if(pub[i].changed){
+            pub[i].changed = 0;
+            
+            if(pub[i].pubFunctPtr(0) == 0)
+                pub[i].changed = 1;
+        }
     }
 }
 
-void DIS_publish(const char* topic, ...){
+uint8_t DIS_publish(const char* topic, ...){
+    if(publishDrop(topic))
+        return 0;
+    
     va_list arguments;
     va_start(arguments, topic);
 
     uint8_t dimensions = 0;
     uint8_t length = 0;
+    uint32_t dataBytes;
+    char* str = 0;
     FormatSpecifier formatSpecifiers[MAX_NUM_OF_FORMAT_SPECIFIERS];
     
     uint16_t i;
@@ -73,26 +295,32 @@ void DIS_publish(const char* topic, ...){
         i++;
     }
     
-    FRM_init();
+    /* a string is the only argument, otherwise no element
+     * takes more than four bytes */
+    dimensions = commaCount;
+    if(dimensions == 0){
+        str = va_arg(arguments, char*);
+        startFrame(topic, 1, strlen(str));
+    }else{
+        dataBytes = (uint32_t)dimensions * parseArrayLength(topic) * 4;
+        startFrame(topic, dimensions, dataBytes);
+    }
     
-    /* go through the first argument and extract the topic */
-    uint16_t strIndex = 0;
-    while((strIndex < len) && (topic[strIndex] != ',') && (topic[strIndex] != ':')){
-        FRM_push(topic[strIndex]);  // send the topic string
-        strIndex++;
+    if(frameDropped){
+        va_end(arguments);
+        return 0;
     }
-    FRM_push(0);    // send the \0 string terminator
     
-    dimensions = commaCount;
+    /* go through the first argument and extract the topic */
+    uint16_t strIndex = pushTopic(topic);
+    
     if(dimensions == 0){
         /* if the dimension == 0, then this is a string,
          *  simply transmit the string */
         FRM_push(1);
         
-        char* data = va_arg(arguments, char*);
-        
         /* send the length */
-        length = strlen(data);
+        length = strlen(str);
         FRM_push((uint8_t)(length & 0x00ff));
         FRM_push((uint8_t)((length & 0xff00) >> 8));
         
@@ -101,7 +329,7 @@ void DIS_publish(const char* topic, ...){
         
         /* finally, send the string */
         for(i = 0; i < length; i++){
-            FRM_push(data[i]);
+            FRM_push(str[i]);
         }
     }else{
         /* if the code gets here, then there is definitely not a string
@@ -148,48 +376,7 @@ void DIS_publish(const char* topic, ...){
         while((strIndex < len) && (i < MAX_NUM_OF_FORMAT_SPECIFIERS)){
             if(topic[strIndex] == ','){
                 strIndex++;
-                
-                /* unlimited spaces after commas */
-                while(topic[strIndex] == ' '){
-                    strIndex++;
-                }
-                
-                if(topic[strIndex] == 'u'){
-                    strIndex++;
-                    if(topic[strIndex] == '8'){
-                        formatSpecifiers[i] = eU8;
-                    }else if(topic[strIndex] == '1'){
-                        /* if the first digit is '1', then the next digit must
-                         * be 6, so there is no need to check for it */
-                        formatSpecifiers[i] = eU16;
-                        strIndex++;
-                    }else if(topic[strIndex] == '3'){
-                        /* if the first digit is '3', then the next digit must
-                         * be 2, so there is no need to check for it */
-                        formatSpecifiers[i] = eU32;
-                        strIndex++;
-                    }
-                }else if(topic[strIndex] == 's'){
-                    strIndex++;
-                    if(topic[strIndex] == '8'){
-                        formatSpecifiers[i] = eS8;
-                    }else if(topic[strIndex] == '1'){
-                        /* if the first digit is '1', then the next digit must
-                         * be 6, so there is no need to check for it */
-                        formatSpecifiers[i] = eS16;
-                        strIndex++;
-                    }else if(topic[strIndex] == '3'){
-                        /* if the first digit is '3', then the next digit must
-                         * be 2, so there is no need to check for it */
-                        formatSpecifiers[i] = eS32;
-                        strIndex++;
-                    }else if(topic[strIndex] == 't'){
-                        /* this is the case which calls for a string to be sent */
-                        formatSpecifiers[i] = eSTRING;
-                        strIndex++;
-                    }
-                }
-                strIndex++;
+                formatSpecifiers[i] = parseFormatSpecifier(topic, &strIndex);
             }else{
                 /* if a comma isn't here, then abort the format specifier */
                 break;
@@ -199,24 +386,7 @@ void DIS_publish(const char* topic, ...){
         }
         
         /* append all format specifiers */
-        uint8_t fsArray[(MAX_NUM_OF_FORMAT_SPECIFIERS >> 1) + 1] = {0};
-        uint8_t fsArrayIndex = 0;
-        i = 0;
-        while(i < dimensions){
-            if((i & 1) == 0){
-                fsArray[fsArrayIndex] = formatSpecifiers[i] & 0x0f;
-            }else{
-                fsArray[fsArrayIndex] |= ((formatSpecifiers[i] & 0x0f) << 4);
-                fsArrayIndex++;
-            }
-
-            i++;
-        }
-
-        uint16_t fsArrayLength = ((i + 1) >> 1);
-        for(i = 0; i < fsArrayLength; i++){
-            FRM_push(fsArray[i]);
-        }
+        pushFormatSpecifiers(formatSpecifiers, dimensions);
 
         /* at this point:
          *     1. topic stored in topic[]
@@ -279,6 +449,25 @@ void DIS_publish(const char* topic, ...){
                     break;
                 }
 
+                case eU12:
+                case eS12:
+                {
+                    uint16_t* data = va_arg(arguments, uint16_t*);
+                    
+                    pushPacked12(data, length);
+                    
+                    break;
+                }
+
+                case eD16:
+                {
+                    int16_t* data = va_arg(arguments, int16_t*);
+                    
+                    pushDelta16(data, length);
+                    
+                    break;
+                }
+
                 case eU32:
                 {
                     uint32_t* data = va_arg(arguments, uint32_t*);
@@ -321,24 +510,85 @@ void DIS_publish(const char* topic, ...){
         }while(i < dimensions);
     }
     
-    FRM_finish();
+    va_end(arguments);
+    
+    finishFrame(topic);
+    
+    return 1;
 }
 
-void DIS_publish_str(const char* topic, char* str){
-    uint16_t length, i;
+uint8_t DIS_publish_fields(const char* topic, uint8_t mask, void** fields){
+    FormatSpecifier formatSpecifiers[MAX_NUM_OF_FORMAT_SPECIFIERS];
+    FormatSpecifier fieldSpecifiers[8];
+    uint8_t numOfFields = 0, dimensions = 1, sentMask = 0;
+    uint16_t strIndex = 0, i;
     
-    FRM_init();
+    if(publishDrop(topic))
+        return 0;
     
-    /* load the topic into the frame */
-    i = 0;
-    while(topic[i] != 0){
-        FRM_push(topic[i]);
-        i++;
+    /* find the end of the topic name */
+    while((topic[strIndex] != 0) && (topic[strIndex] != ',')){
+        strIndex++;
     }
     
-    /* send the string termination character */
+    /* the first dimension is always the u8 mask, followed by
+     * one dimension for each field that is to be sent */
+    formatSpecifiers[0] = eU8;
+    while((topic[strIndex] == ',') && (numOfFields < 8)){
+        strIndex++;
+        fieldSpecifiers[numOfFields] = parseFormatSpecifier(topic, &strIndex);
+        
+        if((mask & (1 << numOfFields))
+                && (dimensions < MAX_NUM_OF_FORMAT_SPECIFIERS)){
+            formatSpecifiers[dimensions] = fieldSpecifiers[numOfFields];
+            sentMask |= (1 << numOfFields);
+            dimensions++;
+        }
+        
+        numOfFields++;
+    }
+    
+    if(sentMask == 0)
+        return 0;
+    
+    /* the mask, then no field takes more than four bytes */
+    if(startFrame(topic, dimensions, 1 + ((uint16_t)(dimensions - 1) * 4)) == 0)
+        return 0;
+    
+    /* load the topic into the frame */
+    pushTopic(topic);
+    
+    /* every field is a single element */
+    FRM_push(dimensions);
+    FRM_push(1);
     FRM_push(0);
     
+    pushFormatSpecifiers(formatSpecifiers, dimensions);
+    
+    FRM_push(sentMask);
+    for(i = 0; i < numOfFields; i++){
+        if(sentMask & (1 << i)){
+            pushScalar(fieldSpecifiers[i], fields[i]);
+        }
+    }
+    
+    finishFrame(topic);
+    
+    return sentMask;
+}
+
+uint8_t DIS_publish_str(const char* topic, char* str){
+    uint16_t length, i;
+    
+    if(publishDrop(topic))
+        return 0;
+    
+    if(startFrame(topic, 1, strlen(str)) == 0)
+        return 0;
+    
+    /* load the topic into the frame */
+    pushTopic(topic);
+    
     /* if the dimension == 0, then this is a string,
      *  simply transmit the string */
     FRM_push(1);
@@ -356,16 +606,23 @@ void DIS_publish_str(const char* topic, char* str){
         FRM_push(str[i]);
     }
     
-    FRM_finish();
+    finishFrame(topic);
+    
+    return 1;
 }
 
-void DIS_publish_u8(const char* topic, uint8_t* data){
+uint8_t DIS_publish_u8(const char* topic, uint8_t* data){
     uint16_t i, dataLength;
     
+    if(publishDrop(topic))
+        return 0;
+    
     /* 'parseTopicString' will initialize the frame and push the topic,
      * dimensions, and headers to the framing library, returning the data
      * length */
-    dataLength = parseTopicString(topic, 1);
+    dataLength = parseTopicString(topic, 1, 1);
+    if(frameDropped)
+        return 0;
     
     /* send the format specifier */
     FRM_push((uint8_t)eU8);
@@ -374,16 +631,23 @@ void DIS_publish_u8(const char* topic, uint8_t* data){
         FRM_push(data[i]);
     }
     
-    FRM_finish();
+    finishFrame(topic);
+    
+    return 1;
 }
 
-void DIS_publish_s8(const char* topic, int8_t* data){
+uint8_t DIS_publish_s8(const char* topic, int8_t* data){
     uint16_t i, dataLength;
     
+    if(publishDrop(topic))
+        return 0;
+    
     /* 'parseTopicString' will initialize the frame and push the topic,
      * dimensions, and headers to the framing library, returning the data
      * length */
-    dataLength = parseTopicString(topic, 1);
+    dataLength = parseTopicString(topic, 1, 1);
+    if(frameDropped)
+        return 0;
     
     /* send the format specifier */
     FRM_push((uint8_t)eS8);
@@ -392,16 +656,23 @@ void DIS_publish_s8(const char* topic, int8_t* data){
         FRM_push((uint8_t)data[i]);
     }
     
-    FRM_finish();
+    finishFrame(topic);
+    
+    return 1;
 }
 
-void DIS_publish_2u8(const char* topic, uint8_t* data0, uint8_t* data1){
+uint8_t DIS_publish_2u8(const char* topic, uint8_t* data0, uint8_t* data1){
     uint16_t i, dataLength;
     
+    if(publishDrop(topic))
+        return 0;
+    
     /* 'parseTopicString' will initialize the frame and push the topic,
      * dimensions, and headers to the framing library, returning the data
      * length */
-    dataLength = parseTopicString(topic, 2);
+    dataLength = parseTopicString(topic, 2, 1);
+    if(frameDropped)
+        return 0;
     
     /* send the format specifiers */
     FRM_push((uint8_t)eU8 | ((uint8_t)((eU8 & 0x0f) << 4)));
@@ -416,16 +687,23 @@ void DIS_publish_2u8(const char* topic, uint8_t* data0, uint8_t* data1){
         FRM_push(data1[i]);
     }
     
-    FRM_finish();
+    finishFrame(topic);
+    
+    return 1;
 }
 
-void DIS_publish_2s8(const char* topic, int8_t* data0, int8_t* data1){
+uint8_t DIS_publish_2s8(const char* topic, int8_t* data0, int8_t* data1){
     uint16_t i, dataLength;
     
+    if(publishDrop(topic))
+        return 0;
+    
     /* 'parseTopicString' will initialize the frame and push the topic,
      * dimensions, and headers to the framing library, returning the data
      * length */
-    dataLength = parseTopicString(topic, 2);
+    dataLength = parseTopicString(topic, 2, 1);
+    if(frameDropped)
+        return 0;
     
     /* send the format specifiers */
     FRM_push((uint8_t)eS8 | ((uint8_t)((eS8 & 0x0f) << 4)));
@@ -440,16 +718,23 @@ void DIS_publish_2s8(const char* topic, int8_t* data0, int8_t* data1){
         FRM_push((uint8_t)data1[i]);
     }
     
-    FRM_finish();
+    finishFrame(topic);
+    
+    return 1;
 }
 
-void DIS_publish_u16(const char* topic, uint16_t* data){
+uint8_t DIS_publish_u16(const char* topic, uint16_t* data){
     uint16_t i, dataLength;
     
+    if(publishDrop(topic))
+        return 0;
+    
     /* 'parseTopicString' will initialize the frame and push the topic,
      * dimensions, and headers to the framing library, returning the data
      * length */
-    dataLength = parseTopicString(topic, 1);
+    dataLength = parseTopicString(topic, 1, 2);
+    if(frameDropped)
+        return 0;
     
     /* send the format specifier */
     FRM_push((uint8_t)eU16);
@@ -459,16 +744,23 @@ void DIS_publish_u16(const char* topic, uint16_t* data){
         FRM_push((uint8_t)((data[i] & 0xff00) >> 8));
     }
     
-    FRM_finish();
+    finishFrame(topic);
+    
+    return 1;
 }
 
-void DIS_publish_s16(const char* topic, int16_t* data){
+uint8_t DIS_publish_s16(const char* topic, int16_t* data){
     uint16_t i, dataLength;
     
+    if(publishDrop(topic))
+        return 0;
+    
     /* 'parseTopicString' will initialize the frame and push the topic,
      * dimensions, and headers to the framing library, returning the data
      * length */
-    dataLength = parseTopicString(topic, 1);
+    dataLength = parseTopicString(topic, 1, 2);
+    if(frameDropped)
+        return 0;
     
     /* send the format specifier */
     FRM_push((uint8_t)eS16);
@@ -478,16 +770,23 @@ void DIS_publish_s16(const char* topic, int16_t* data){
         FRM_push((uint8_t)((data[i] & 0xff00) >> 8));
     }
     
-    FRM_finish();
+    finishFrame(topic);
+    
+    return 1;
 }
 
-void DIS_publish_2u16(const char* topic, uint16_t* data0, uint16_t* data1){
+uint8_t DIS_publish_2u16(const char* topic, uint16_t* data0, uint16_t* data1){
     uint16_t i, dataLength;
     
+    if(publishDrop(topic))
+        return 0;
+    
     /* 'parseTopicString' will initialize the frame and push the topic,
      * dimensions, and headers to the framing library, returning the data
      * length */
-    dataLength = parseTopicString(topic, 2);
+    dataLength = parseTopicString(topic, 2, 2);
+    if(frameDropped)
+        return 0;
     
     /* send the format specifiers */
     FRM_push((uint8_t)eU16 | ((uint8_t)((eU16 & 0x0f) << 4)));
@@ -504,16 +803,23 @@ void DIS_publish_2u16(const char* topic, uint16_t* data0, uint16_t* data1){
         FRM_push((uint8_t)((data1[i] & 0xff00) >> 8));
     }
     
-    FRM_finish();
+    finishFrame(topic);
+    
+    return 1;
 }
 
-void DIS_publish_2s16(const char* topic, int16_t* data0, int16_t* data1){
+uint8_t DIS_publish_2s16(const char* topic, int16_t* data0, int16_t* data1){
     uint16_t i, dataLength;
     
+    if(publishDrop(topic))
+        return 0;
+    
     /* 'parseTopicString' will initialize the frame and push the topic,
      * dimensions, and headers to the framing library, returning the data
      * length */
-    dataLength = parseTopicString(topic, 2);
+    dataLength = parseTopicString(topic, 2, 2);
+    if(frameDropped)
+        return 0;
     
     /* send the format specifiers */
     FRM_push((uint8_t)eS16 | ((uint8_t)((eS16 & 0x0f) << 4)));
@@ -530,16 +836,169 @@ void DIS_publish_2s16(const char* topic, int16_t* data0, int16_t* data1){
         FRM_push((uint8_t)((data1[i] & 0xff00) >> 8));
     }
     
-    FRM_finish();
+    finishFrame(topic);
+    
+    return 1;
+}
+
+uint8_t DIS_publish_2s12(const char* topic, int16_t* data0, int16_t* data1){
+    uint16_t dataLength;
+    
+    if(publishDrop(topic))
+        return 0;
+    
+    /* 'parseTopicString' will initialize the frame and push the topic,
+     * dimensions, and headers to the framing library, returning the data
+     * length */
+    dataLength = parseTopicString(topic, 2, 2);
+    if(frameDropped)
+        return 0;
+    
+    /* send the format specifiers */
+    FRM_push((uint8_t)eS12 | ((uint8_t)((eS12 & 0x0f) << 4)));
+    
+    /* send each array packed */
+    pushPacked12((uint16_t*)data0, dataLength);
+    pushPacked12((uint16_t*)data1, dataLength);
+    
+    finishFrame(topic);
+    
+    return 1;
+}
+
+uint8_t DIS_publish_2d16(const char* topic, int16_t* data0, int16_t* data1){
+    uint16_t dataLength;
+    
+    if(publishDrop(topic))
+        return 0;
+    
+    /* 'parseTopicString' will initialize the frame and push the topic,
+     * dimensions, and headers to the framing library, returning the data
+     * length */
+    dataLength = parseTopicString(topic, 2, 3);
+    if(frameDropped)
+        return 0;
+    
+    /* send the format specifiers */
+    FRM_push((uint8_t)eD16 | ((uint8_t)((eD16 & 0x0f) << 4)));
+    
+    /* send each array delta-coded */
+    pushDelta16(data0, dataLength);
+    pushDelta16(data1, dataLength);
+    
+    finishFrame(topic);
+    
+    return 1;
+}
+
+uint8_t DIS_publishArraysBegin(const char* topic, FormatSpecifier format,
+        int16_t* data0, int16_t* data1){
+    uint16_t dataLength;
+    
+    if((format != eS16) && (format != eS12) && (format != eD16))
+        return 0;
+    
+    if(publishDrop(topic))
+        return 0;
+    
+    /* 'parseTopicString' will initialize the frame and push the topic,
+     * dimensions, and headers to the framing library, returning the data
+     * length */
+    dataLength = parseTopicString(topic, 2, (format == eD16) ? 3 : 2);
+    if(frameDropped)
+        return 0;
+    
+    /* send the format specifiers */
+    FRM_push((uint8_t)format | ((uint8_t)((format & 0x0f) << 4)));
+    
+    /* the arrays follow a slice at a time */
+    slice.topic = topic;
+    slice.data[0] = data0;
+    slice.data[1] = data1;
+    slice.length = dataLength;
+    slice.index = 0;
+    slice.previous = 0;
+    slice.dimension = 0;
+    slice.format = format;
+    slice.active = 1;
+    
+    return 1;
+}
+
+uint8_t DIS_publishSlice(uint16_t budget){
+    uint16_t pushed = 0;
+    uint16_t limit = budget;
+    
+    if(slice.active == 0)
+        return 1;
+    
+    /* never push more than the channel takes without waiting */
+    if(limit > FRM_pushable())
+        limit = FRM_pushable();
+    
+    /* each element takes at most three bytes */
+    while((slice.dimension < 2) && ((pushed + 3) <= limit)){
+        int16_t* data = slice.data[slice.dimension];
+        
+        switch(slice.format){
+            case eS12:
+            {
+                slice.index += pushPacked12Pair((uint16_t*)data, slice.index, slice.length);
+                pushed += 3;
+                break;
+            }
+            
+            case eD16:
+            {
+                pushDelta16Element(data[slice.index], &slice.previous);
+                slice.index++;
+                pushed += 3;
+                break;
+            }
+            
+            default:
+            {
+                pushScalar(eS16, &data[slice.index]);
+                slice.index++;
+                pushed += 2;
+            }
+        }
+        
+        if(slice.index >= slice.length){
+            slice.dimension++;
+            slice.index = 0;
+            slice.previous = 0;
+        }
+    }
+    
+    if(slice.dimension < 2)
+        return 0;
+    
+    if(FRM_writeable() < FRM_finishBytes())
+        return 0;
+    
+    slice.active = 0;
+    finishFrame(slice.topic);
+    
+    return 1;
 }
 
-void DIS_publish_u32(const char* topic, uint32_t* data){
+uint8_t DIS_isPublishing(void){
+    return slice.active;
+}
+
+uint8_t DIS_publish_u32(const char* topic, uint32_t* data){
     uint16_t i, dataLength;
     
+    if(publishDrop(topic))
+        return 0;
+    
     /* 'parseTopicString' will initialize the frame and push the topic,
      * dimensions, and headers to the framing library, returning the data
      * length */
-    dataLength = parseTopicString(topic, 1);
+    dataLength = parseTopicString(topic, 1, 4);
+    if(frameDropped)
+        return 0;
     
     /* send the format specifier */
     FRM_push((uint8_t)eU32);
@@ -551,16 +1010,23 @@ void DIS_publish_u32(const char* topic, uint32_t* data){
         FRM_push((uint8_t)((data[i] & 0xff000000) >> 24));
     }
     
-    FRM_finish();
+    finishFrame(topic);
+    
+    return 1;
 }
 
-void DIS_publish_s32(const char* topic, int32_t* data){
+uint8_t DIS_publish_s32(const char* topic, int32_t* data){
     uint16_t i, dataLength;
     
+    if(publishDrop(topic))
+        return 0;
+    
     /* 'parseTopicString' will initialize the frame and push the topic,
      * dimensions, and headers to the framing library, returning the data
      * length */
-    dataLength = parseTopicString(topic, 1);
+    dataLength = parseTopicString(topic, 1, 4);
+    if(frameDropped)
+        return 0;
     
     /* send the format specifier */
     FRM_push((uint8_t)eS32);
@@ -572,42 +1038,463 @@ void DIS_publish_s32(const char* topic, int32_t* data){
         FRM_push((uint8_t)((data[i] & 0xff000000) >> 24));
     }
     
-    FRM_finish();
+    finishFrame(topic);
+    
+    return 1;
 }
 
-uint16_t parseTopicString(const char* topic, uint8_t dimensions){
-    uint16_t dataLength = 1, strIndex = 0;
-    uint16_t i;
-    
-    FRM_init();
+static FormatSpecifier parseFormatSpecifier(const char* topic, uint16_t* strIndex){
+    FormatSpecifier fs = eNONE;
+    uint16_t index = *strIndex;
     
-    /* load the topic into the frame */
-    strIndex = 0;
-    while((topic[strIndex] != 0)
-            && (topic[strIndex] != ':')){
-        FRM_push(topic[strIndex]);
-        strIndex++;
+    /* unlimited spaces after commas */
+    while(topic[index] == ' '){
+        index++;
+    }
+
+    if(topic[index] == 'u'){
+        index++;
+        if(topic[index] == '8'){
+            fs = eU8;
+        }else if(topic[index] == '1'){
+            /* if the first digit is '1', then the next digit is
+             * either 6 or 2 */
+            index++;
+            fs = (topic[index] == '2') ? eU12 : eU16;
+        }else if(topic[index] == '3'){
+            /* if the first digit is '3', then the next digit must
+             * be 2, so there is no need to check for it */
+            fs = eU32;
+            index++;
+        }
+    }else if(topic[index] == 's'){
+        index++;
+        if(topic[index] == '8'){
+            fs = eS8;
+        }else if(topic[index] == '1'){
+            /* if the first digit is '1', then the next digit is
+             * either 6 or 2 */
+            index++;
+            fs = (topic[index] == '2') ? eS12 : eS16;
+        }else if(topic[index] == '3'){
+            /* if the first digit is '3', then the next digit must
+             * be 2, so there is no need to check for it */
+            fs = eS32;
+            index++;
+        }else if(topic[index] == 't'){
+            /* this is the case which calls for a string to be sent */
+            fs = eSTRING;
+            index++;
+        }
+    }else if(topic[index] == 'd'){
+        /* the only delta-coded format is 'd16' */
+        index++;
+        fs = eD16;
+        index++;
     }
+    index++;
     
-    /* send the string termination character */
-    FRM_push(0);
+    *strIndex = index;
     
-    if(topic[strIndex] == ':'){
-        strIndex++;
+    return fs;
+}
+
+static void pushFormatSpecifiers(FormatSpecifier* formatSpecifiers, uint8_t dimensions){
+    /* two format specifiers are packed into each byte */
+    uint8_t fsArray[(MAX_NUM_OF_FORMAT_SPECIFIERS >> 1) + 1] = {0};
+    uint8_t fsArrayIndex = 0;
+    uint16_t i = 0;
+    while(i < dimensions){
+        if((i & 1) == 0){
+            fsArray[fsArrayIndex] = formatSpecifiers[i] & 0x0f;
+        }else{
+            fsArray[fsArrayIndex] |= ((formatSpecifiers[i] & 0x0f) << 4);
+            fsArrayIndex++;
+        }
+
+        i++;
+    }
+
+    uint16_t fsArrayLength = ((i + 1) >> 1);
+    for(i = 0; i < fsArrayLength; i++){
+        FRM_push(fsArray[i]);
+    }
+}
+
+static void pushScalar(FormatSpecifier formatSpecifier, void* data){
+    switch(formatSpecifier){
+        case eU8:
+        case eS8:
+        {
+            FRM_push(*(uint8_t*)data);
+            break;
+        }
         
-        /* copy the numeric part of the string into numStr */
-        char numStr[8] = {0};
-        i = 0;
-        while(topic[strIndex] != 0){
-            numStr[i] = topic[strIndex];
-            i++;
-            strIndex++;
+        case eU12:
+        case eS12:
+        {
+            pushPacked12((uint16_t*)data, 1);
+            break;
+        }
+        
+        case eD16:
+        {
+            pushDelta16((int16_t*)data, 1);
+            break;
+        }
+        
+        case eU16:
+        case eS16:
+        {
+            uint16_t value = *(uint16_t*)data;
+            FRM_push((uint8_t)(value & 0x00ff));
+            FRM_push((uint8_t)((value & 0xff00) >> 8));
+            break;
+        }
+        
+        case eU32:
+        case eS32:
+        {
+            uint32_t value = *(uint32_t*)data;
+            FRM_push((uint8_t)(value & 0x000000ff));
+            FRM_push((uint8_t)((value & 0x0000ff00) >> 8));
+            FRM_push((uint8_t)((value & 0x00ff0000) >> 16));
+            FRM_push((uint8_t)((value & 0xff000000) >> 24));
+            break;
+        }
+        
+        default:
+        {
+            
+        }
+    }
+}
+
+static void pushPacked12(uint16_t* data, uint16_t length){
+    uint16_t i = 0;
+    
+    while(i < length){
+        i += pushPacked12Pair(data, i, length);
+    }
+}
+
+static uint16_t pushPacked12Pair(uint16_t* data, uint16_t index, uint16_t length){
+    /* two 12-bit values are packed into three bytes, the
+     * low nibble of the middle byte belonging to the first */
+    if((index + 1) < length){
+        uint16_t value0 = data[index];
+        uint16_t value1 = data[index + 1];
+        
+        FRM_push((uint8_t)(value0 & 0x00ff));
+        FRM_push((uint8_t)(((value0 & 0x0f00) >> 8) | ((value1 & 0x000f) << 4)));
+        FRM_push((uint8_t)((value1 & 0x0ff0) >> 4));
+        
+        return 2;
+    }
+    
+    /* an odd value out takes two bytes */
+    FRM_push((uint8_t)(data[index] & 0x00ff));
+    FRM_push((uint8_t)((data[index] & 0x0f00) >> 8));
+    
+    return 1;
+}
+
+static void pushDelta16(int16_t* data, uint16_t length){
+    int16_t previous = 0;
+    uint16_t i;
+    
+    for(i = 0; i < length; i++){
+        pushDelta16Element(data[i], &previous);
+    }
+}
+
+static void pushDelta16Element(int16_t value, int16_t* previous){
+    /* first-order prediction, the difference is zig-zag mapped so
+     * that small differences of either sign become small codes */
+    int16_t delta = value - *previous;
+    uint16_t code = ((uint16_t)delta << 1) ^ (uint16_t)(delta >> 15);
+    *previous = value;
+    
+    /* 7 bits per byte, least significant first, the msb is set
+     * on every byte except the last */
+    while(code >= 0x80){
+        FRM_push((uint8_t)(code & 0x7f) | 0x80);
+        code >>= 7;
+    }
+    FRM_push((uint8_t)code);
+}
+
+static uint8_t startFrame(const char* topic, uint8_t dimensions, uint32_t dataBytes){
+    uint16_t nameLength = 0;
+    uint32_t bytes;
+    
+    while((topic[nameLength] != 0)
+            && (topic[nameLength] != ':')
+            && (topic[nameLength] != ',')){
+        nameLength++;
+    }
+    
+    /* the topic and its terminator, the dimensions, the length, the format
+     * specifiers two to a byte, then the data; the frame module drops the
+     * frame whole if it might not all be sent */
+    bytes = (uint32_t)nameLength + 1 + 1 + 2 + ((dimensions + 1) >> 1) + dataBytes;
+    if(bytes > 0xffff)
+        bytes = 0xffff;
+    
+    frameDropped = (FRM_init((uint16_t)bytes) == 0);
+    
+    return !frameDropped;
+}
+
+static uint16_t dimensionBytes(FormatSpecifier formatSpecifier, uint16_t length,
+        uint8_t* data, uint16_t maxBytes){
+    /* worked out in 32 bits, since a large length would wrap in 16 */
+    uint32_t bytes = 0;
+    
+    switch(formatSpecifier){
+        case eU16:
+        case eS16:
+        {
+            bytes = (uint32_t)length << 1;
+            break;
+        }
+        
+        case eU32:
+        case eS32:
+        {
+            bytes = (uint32_t)length << 2;
+            break;
+        }
+        
+        case eU12:
+        case eS12:
+        {
+            /* packed, three bytes for every two elements */
+            bytes = (((uint32_t)length * 3) + 1) >> 1;
+            break;
+        }
+        
+        case eD16:
+        {
+            /* every element ends with a byte with the msb clear, and a
+             * 16-bit code never takes more than three bytes */
+            uint16_t i = 0;
+            uint8_t run = 0;
+            while((i < length) && (bytes < maxBytes)){
+                if((data[bytes] & 0x80) == 0){
+                    i++;
+                    run = 0;
+                }else if(++run >= 3){
+                    break;
+                }
+                bytes++;
+            }
+            
+            /* the frame ended before the last element, or a code was
+             * too long */
+            if(i < length)
+                bytes = (uint32_t)maxBytes + 1;
+            break;
+        }
+        
+        default:
+        {
+            bytes = length;
+        }
+    }
+    
+    /* any dimension that doesn't fit is reported as one byte too many,
+     * which the caller drops; the frames are far smaller than 0xffff */
+    if(bytes > maxBytes)
+        bytes = (uint32_t)maxBytes + 1;
+    
+    return (uint16_t)bytes;
+}
+
+static uint8_t topicMatches(const char* topic0, const char* topic1){
+    /* compare only the topic names, ignoring any length and
+     * format specifiers that follow them */
+    uint16_t i = 0;
+    while(1){
+        char c0 = topic0[i];
+        char c1 = topic1[i];
+        
+        if((c0 == ':') || (c0 == ','))
+            c0 = 0;
+        if((c1 == ':') || (c1 == ','))
+            c1 = 0;
+        
+        if(c0 != c1)
+            return 0;
+        
+        if(c0 == 0)
+            return 1;
+        
+        i++;
+    }
+}
+
+static Conflation* findConflation(const char* topic){
+    uint16_t i;
+    
+    for(i = 0; i < MAX_NUM_OF_CONFLATED_TOPICS; i++){
+        if((conflation[i].topic != 0) 
+                && topicMatches(conflation[i].topic, topic)){
+            return &conflation[i];
+        }
+    }
+    
+    return 0;
+}
+
+static uint8_t publishDrop(const char* topic){
+    Conflation* c = findConflation(topic);
+    
+    /* frames can't be interleaved, so nothing else goes out while a sliced
+     * publish is under way; waiting for it here would hold up the caller
+     * for the whole frame */
+    if(slice.active){
+        if(c != 0)
+            c->drops++;
+        
+        return 1;
+    }
+    
+    /* when the last frame of a conflated topic hasn't yet left the channel,
+     * drop this one so that the next publish after the channel drains
+     * carries the freshest value */
+    if((c != 0) && (c->pending != 0)){
+        if(FRM_isQueued(c->txMarker)){
+            c->drops++;
+            return 1;
         }
         
-        /* convert the ASCII number into an integer */
-        dataLength = (uint16_t)atol(numStr);
+        c->pending = 0;
     }
     
+    return 0;
+}
+
+static void finishFrame(const char* topic){
+    Conflation* c;
+    
+    /* a dropped frame never reaches the channel, so it isn't pending */
+    if(frameDropped)
+        return;
+    
+    FRM_finish();
+    
+    c = findConflation(topic);
+    if(c != 0){
+        c->txMarker = FRM_txMarker();
+        c->pending = 1;
+    }
+}
+
+static uint16_t pushTopic(const char* topic){
+    uint16_t strIndex = 0;
+    uint16_t i;
+    
+    /* find the end of the topic name */
+    while((topic[strIndex] != 0)
+            && (topic[strIndex] != ':')
+            && (topic[strIndex] != ',')){
+        strIndex++;
+    }
+    
+    /* once the host knows the topic ids, send the id alone */
+    if(compactTopics){
+        for(i = 0; i < MAX_NUM_OF_PUBLISHED_TOPICS; i++){
+            if((pubTopic[i] != 0) && topicMatches(pubTopic[i], topic)){
+                FRM_push(TOPIC_ID_FLAG | (MAX_NUM_OF_SUBSCRIPTIONS + i));
+                return strIndex;
+            }
+        }
+    }
+    
+    for(i = 0; i < strIndex; i++){
+        FRM_push(topic[i]);
+    }
+    
+    /* send the string termination character */
+    FRM_push(0);
+    
+    return strIndex;
+}
+
+static uint8_t announceTopics(void){
+    uint16_t length = 0, i, j;
+    
+    /* the announcement is a single string of comma-separated topic
+     * names in id order, subscriptions first, then published topics;
+     * unused ids are left empty */
+    for(i = 0; i < MAX_NUM_OF_SUBSCRIPTIONS; i++){
+        if(sub[i].topic != 0)
+            length += strlen(sub[i].topic);
+        length++;
+    }
+    for(i = 0; i < MAX_NUM_OF_PUBLISHED_TOPICS; i++){
+        j = 0;
+        while((pubTopic[i] != 0) && (pubTopic[i][j] != 0)
+                && (pubTopic[i][j] != ':') && (pubTopic[i][j] != ',')){
+            j++;
+        }
+        length += j + 1;
+    }
+    length--;   /* no comma after the last name */
+    
+    if(startFrame(TOPICS_TOPIC, 1, length) == 0)
+        return 0;
+    
+    /* the announcement always carries the full topic string */
+    i = 0;
+    while(TOPICS_TOPIC[i] != 0){
+        FRM_push(TOPICS_TOPIC[i]);
+        i++;
+    }
+    FRM_push(0);
+    
+    FRM_push(1);
+    FRM_push((uint8_t)(length & 0x00ff));
+    FRM_push((uint8_t)((length & 0xff00) >> 8));
+    FRM_push(eSTRING);
+    
+    for(i = 0; i < MAX_NUM_OF_SUBSCRIPTIONS; i++){
+        if(i != 0)
+            FRM_push(',');
+        
+        j = 0;
+        while((sub[i].topic != 0) && (sub[i].topic[j] != 0)){
+            FRM_push(sub[i].topic[j]);
+            j++;
+        }
+    }
+    for(i = 0; i < MAX_NUM_OF_PUBLISHED_TOPICS; i++){
+        FRM_push(',');
+        
+        j = 0;
+        while((pubTopic[i] != 0) && (pubTopic[i][j] != 0)
+                && (pubTopic[i][j] != ':') && (pubTopic[i][j] != ',')){
+            FRM_push(pubTopic[i][j]);
+            j++;
+        }
+    }
+    
+    FRM_finish();
+    
+    return 1;
+}
+
+uint16_t parseTopicString(const char* topic, uint8_t dimensions, uint8_t elementBytes){
+    uint16_t dataLength = parseArrayLength(topic);
+    
+    /* the caller checks frameDropped; nothing is pushed for a dropped frame */
+    if(startFrame(topic, dimensions, (uint32_t)dimensions * dataLength * elementBytes) == 0)
+        return dataLength;
+    
+    /* load the topic into the frame */
+    pushTopic(topic);
+    
     FRM_push(dimensions);
 
     /* send the length as two bytes */
@@ -617,6 +1504,32 @@ uint16_t parseTopicString(const char* topic, uint8_t dimensions){
     return dataLength;
 }
 
+static uint16_t parseArrayLength(const char* topic){
+    uint16_t strIndex = 0;
+    uint16_t i;
+    
+    while((topic[strIndex] != 0) && (topic[strIndex] != ':')){
+        strIndex++;
+    }
+    
+    if(topic[strIndex] != ':')
+        return 1;
+    
+    strIndex++;
+    
+    /* copy the numeric part of the string into numStr */
+    char numStr[8] = {0};
+    i = 0;
+    while((topic[strIndex] != 0) && (topic[strIndex] != ',') && (i < 7)){
+        numStr[i] = topic[strIndex];
+        i++;
+        strIndex++;
+    }
+    
+    /* convert the ASCII number into an integer */
+    return (uint16_t)atol(numStr);
+}
+
 void DIS_subscribe(const char* topic, void (*functPtr)()){
     /* find an empty subscription slot */
     uint16_t i;
@@ -630,13 +1543,32 @@ void DIS_subscribe(const char* topic, void (*functPtr)()){
     
     /* subscribe to the 'found' slot */
     if(found == 1){
-        /* copy the function pointer and the topic */
+        /* keep the function pointer and the topic */
         sub[i].subFunctPtr = functPtr;
-        
-        uint16_t j = 0;
-        while(topic[j] != 0){
-            sub[i].topic[j] = topic[j];
-            j++;
+        sub[i].topic = topic;
+    }
+}
+
+void DIS_receiveChunks(const char* topic, uint8_t* dest, uint16_t maxLength,
+        void (*doneFunctPtr)(uint16_t length)){
+    uint16_t i;
+    
+    for(i = 0; i < MAX_NUM_OF_CHUNKED_TOPICS; i++){
+        if(chunks[i].topic == 0){
+            chunks[i].topic = topic;
+            chunks[i].dest = dest;
+            chunks[i].maxLength = maxLength;
+            chunks[i].total = 0;
+            chunks[i].expected = 0;
+            chunks[i].unacked = 0;
+            chunks[i].ackPending = 0;
+            chunks[i].doneFunctPtr = doneFunctPtr;
+            
+            /* the chunks arrive as an ordinary subscription, so they
+             * are also addressable by topic id */
+            DIS_subscribe(topic, &receiveChunk);
+            
+            break;
         }
     }
 }
@@ -648,7 +1580,7 @@ void DIS_unsubscribe(void (*functPtr)()){
         /* copy the function pointer and the topic */
         if(sub[i].subFunctPtr == functPtr){
             sub[i].subFunctPtr = 0;
-            sub[i].topic[0] = 0;
+            sub[i].topic = 0;
         }
     }
 }
@@ -656,19 +1588,26 @@ void DIS_unsubscribe(void (*functPtr)()){
 void DIS_process(void){
     /* retrieve any messages from the framing buffer 
      * and process them appropriately */
-    uint8_t data[MAX_RECEIVE_MESSAGE_LEN];
-    if(FRM_pull(data) > 0){
+    uint16_t frameLength = FRM_pull(rxFrameData);
+    if(frameLength > 0){
+        uint8_t* data = rxFrameData;
         char topic[MAX_TOPIC_STR_LEN] = {0};
+        int16_t topicId = -1;
         uint16_t i = 0;
         uint16_t dataIndex = 0;
         
         /* decompose the message into its constituent parts */
-        while(data[i] != 0){
-            topic[i] = data[i];
-            i++;
-        }
+        if(data[0] & TOPIC_ID_FLAG){
+            topicId = data[0] & ~TOPIC_ID_FLAG;
+            dataIndex = 1;
+        }else{
+            while((data[i] != 0) && (i < (MAX_TOPIC_STR_LEN - 1))){
+                topic[i] = data[i];
+                i++;
+            }
 
-        dataIndex = i + 1;
+            dataIndex = i + 1;
+        }
         
         rxMsg.dimensions = data[dataIndex++] & 0x0f;
         rxMsg.length = (uint16_t)data[dataIndex++];
@@ -676,24 +1615,15 @@ void DIS_process(void){
         
         rxMsg.length8bit = 0;
         
+        if(rxMsg.dimensions > MAX_NUM_OF_FORMAT_SPECIFIERS)
+            return;
+        
         for(i = 0; i < rxMsg.dimensions; i++){
             if((i & 1) == 0){
                 rxMsg.formatSpecifiers[i] = (FormatSpecifier)(data[dataIndex] & 0x0f);
             }else{
                 rxMsg.formatSpecifiers[i] = (FormatSpecifier)((data[dataIndex++] & 0xf0) >> 4);
             }
-            
-            if((rxMsg.formatSpecifiers[i] == eSTRING)
-                    || (rxMsg.formatSpecifiers[i] == eU8)
-                    || (rxMsg.formatSpecifiers[i] == eS8)){
-                rxMsg.length8bit += rxMsg.length;
-            }else if((rxMsg.formatSpecifiers[i] == eU16)
-                    || (rxMsg.formatSpecifiers[i] == eS16)){
-                rxMsg.length8bit += (rxMsg.length << 1);
-            }else if((rxMsg.formatSpecifiers[i] == eU32)
-                    || (rxMsg.formatSpecifiers[i] == eS32)){
-                rxMsg.length8bit += (rxMsg.length << 2);
-            }
         }
         
         /* ensure that the data index is incremented
@@ -702,183 +1632,359 @@ void DIS_process(void){
             dataIndex++;
         }
         
-        /* keep from having to re-copy the buffer */
-        uint8_t* dataWithOffset = data + dataIndex;
+        if(dataIndex > frameLength)
+            return;
         
-        /* copy the data to the rx array */
-        for(i = 0; i < rxMsg.length8bit; i++){
-            rxMsg.data[i] = dataWithOffset[i];
+        /* the message data is left in place in the frame */
+        rxMsg.data = data + dataIndex;
+        
+        /* find where each dimension starts; the delta-coded dimensions
+         * must be scanned for their length */
+        for(i = 0; i < rxMsg.dimensions; i++){
+            rxMsg.offsets[i] = rxMsg.length8bit;
+            rxMsg.length8bit += dimensionBytes(rxMsg.formatSpecifiers[i],
+                    rxMsg.length, rxMsg.data + rxMsg.length8bit,
+                    frameLength - dataIndex - rxMsg.length8bit);
+            
+            /* drop messages that claim more data than was received, before
+             * the next dimension is scanned beyond the end of the frame */
+            if(rxMsg.length8bit > (frameLength - dataIndex))
+                return;
         }
         
-        /* go through the active subscriptions and execute any
-         * functions that are subscribed to the received topics */
-        for(i = 0; i < MAX_NUM_OF_SUBSCRIPTIONS; i++){
-            if(strcmp(topic, sub[i].topic) == 0){
-                /* execute the function if it isn't empty */
-                if(sub[i].subFunctPtr != 0){
-                    sub[i].subFunctPtr();
+        if(topicId >= 0){
+            /* the id of a subscribed topic is the index of its subscription */
+            if((topicId < MAX_NUM_OF_SUBSCRIPTIONS)
+                    && (sub[topicId].subFunctPtr != 0)){
+                rxTopic = sub[topicId].topic;
+                sub[topicId].subFunctPtr();
+            }
+        }else if(strcmp(topic, TOPICS_TOPIC) == 0){
+            /* the host is asking for the topic ids, after which the ids
+             * are used in place of the topic strings; until the reply is
+             * queued, which waits for any sliced publish to finish and for
+             * the credits to send it, the host has no ids to decode */
+            if((slice.active == 0) && announceTopics()){
+                announcePending = 0;
+                compactTopics = 1;
+            }else{
+                announcePending = 1;
+                compactTopics = 0;
+            }
+        }else{
+            /* a host that knows the ids sends by id, so a topic string
+             * means a host that has (re)connected without asking for them */
+            compactTopics = 0;
+            
+            /* go through the active subscriptions and execute any
+             * functions that are subscribed to the received topics */
+            for(i = 0; i < MAX_NUM_OF_SUBSCRIPTIONS; i++){
+                if((sub[i].topic != 0) && (strcmp(topic, sub[i].topic) == 0)){
+                    /* execute the function if it isn't empty */
+                    if(sub[i].subFunctPtr != 0){
+                        rxTopic = sub[i].topic;
+                        sub[i].subFunctPtr();
+                    }
                 }
             }
         }
     }
 }
 
-uint16_t DIS_getElements(uint16_t element, void* destArray){
+uint16_t DIS_getView(uint16_t element, DispatchView* view){
+    view->data = 0;
+    view->count = 0;
+    view->bytes = 0;
+    view->format = eNONE;
+    
+    if(element >= rxMsg.dimensions)
+        return 0;
+    
+    view->data = rxMsg.data + rxMsg.offsets[element];
+    view->count = rxMsg.length;
+    view->format = rxMsg.formatSpecifiers[element];
+    
+    if((element + 1) < rxMsg.dimensions){
+        view->bytes = rxMsg.offsets[element + 1] - rxMsg.offsets[element];
+    }else{
+        view->bytes = rxMsg.length8bit - rxMsg.offsets[element];
+    }
+    
+    return view->count;
+}
+
+int32_t DIS_viewElement(const DispatchView* view, uint16_t index){
+    if(index >= view->count)
+        return 0;
+    
+    if(view->format == eD16){
+        /* each delta-coded element depends upon all of those before it */
+        uint16_t byteIndex = 0, i;
+        int16_t value = 0;
+        
+        for(i = 0; i <= index; i++){
+            value += (int16_t)readVarint(view->data, &byteIndex, view->bytes);
+        }
+        
+        return value;
+    }
+    
+    return readFixedElement(view, index);
+}
+
+int32_t DIS_getScalar(uint16_t element){
+    DispatchView view;
+    
+    DIS_getView(element, &view);
+    
+    return DIS_viewElement(&view, 0);
+}
+
+uint16_t DIS_getElements(uint16_t element, void* destArray, uint16_t maxElements){
+    DispatchView view;
     uint16_t i;
     
-    uint16_t currentIndex = getCurrentRxPointerIndex(element);
+    if(DIS_getView(element, &view) == 0)
+        return 0;
     
-    switch(rxMsg.formatSpecifiers[element]){
+    /* a frame larger than the caller expects is cut short rather than
+     * overrunning the destination */
+    if(view.count > maxElements)
+        view.count = maxElements;
+    
+    switch(view.format){
         case eNONE:
         case eSTRING:
+        case eU8:
+        case eS8:
         {
-            // typecast to a char
-            char* data = (char*)destArray;
-            
             // copy data to destination array
-            i = 0;
-            while(i < rxMsg.length8bit){
-                data[i] = rxMsg.data[i];
-                i++;
+            uint8_t* data = (uint8_t*)destArray;
+            for(i = 0; i < view.count; i++){
+                data[i] = view.data[i];
             }
             
             break;
         }
         
-        case eU8:
+        case eU16:
+        case eS16:
+        case eU12:
+        case eS12:
         {
-            // typecast to a char
-            uint8_t* data = (uint8_t*)destArray;
-            
             // copy data to destination array
-            i = 0;
-            while(i < rxMsg.length8bit){
-                data[i] = (uint8_t)rxMsg.data[currentIndex + i];
-                i++;
+            uint16_t* data = (uint16_t*)destArray;
+            for(i = 0; i < view.count; i++){
+                data[i] = (uint16_t)readFixedElement(&view, i);
             }
             
             break;
         }
         
-        case eS8:
+        case eD16:
         {
-            // typecast to a char
-            int8_t* data = (int8_t*)destArray;
-            
-            // copy data to destination array
-            i = 0;
-            while(i < rxMsg.length8bit){
-                data[i] = (int8_t)rxMsg.data[currentIndex + i];
-                i++;
+            // decode data to destination array in a single pass
+            int16_t* data = (int16_t*)destArray;
+            int16_t previous = 0;
+            uint16_t byteIndex = 0;
+            for(i = 0; i < view.count; i++){
+                previous += (int16_t)readVarint(view.data, &byteIndex, view.bytes);
+                data[i] = previous;
             }
             
             break;
         }
         
-        case eU16:
+        case eU32:
+        case eS32:
         {
-            // typecast to a unsigned int
-            uint16_t* data = (uint16_t*)destArray;
-            
             // copy data to destination array
-            i = 0;
-            while(i < rxMsg.length8bit){
-                uint16_t dataIndex = i >> 1;
-                data[dataIndex] = (uint16_t)rxMsg.data[currentIndex + i];
-                i++;
-                data[dataIndex] |= (uint16_t)rxMsg.data[currentIndex + i] << 8;
-                i++;
+            uint32_t* data = (uint32_t*)destArray;
+            for(i = 0; i < view.count; i++){
+                data[i] = (uint32_t)readFixedElement(&view, i);
             }
             
             break;
         }
         
+        default:
+        {
+            
+        }
+    }
+    
+    return view.count;
+}
+
+static void receiveChunk(void){
+    ChunkTransfer* c = 0;
+    DispatchView view;
+    uint16_t offset, total, length, i;
+    
+    for(i = 0; i < MAX_NUM_OF_CHUNKED_TOPICS; i++){
+        if((chunks[i].topic != 0) && topicMatches(chunks[i].topic, rxTopic)){
+            c = &chunks[i];
+            break;
+        }
+    }
+    
+    /* the chunk is raw bytes, so any other format is ignored */
+    if((c == 0) || (DIS_getView(0, &view) < CHUNK_HEADER_LEN)
+            || (view.format != eU8))
+        return;
+    
+    /* the chunk starts with its offset and the total length */
+    offset = (uint16_t)view.data[0] | ((uint16_t)view.data[1] << 8);
+    total = (uint16_t)view.data[2] | ((uint16_t)view.data[3] << 8);
+    length = view.count - CHUNK_HEADER_LEN;
+    
+    if((total > c->maxLength) || (((uint32_t)offset + length) > total)){
+        sendChunkAck(c, CHUNK_REFUSED);
+        c->expected = 0;
+        return;
+    }
+    
+    /* the first chunk (re)starts the transfer */
+    if(offset == 0){
+        c->total = total;
+        c->expected = 0;
+        c->unacked = 0;
+    }
+    
+    /* go-back-n: anything but the next chunk is discarded and the host
+     * is told where to resume */
+    if((offset != c->expected) || (total != c->total)){
+        sendChunkAck(c, c->expected);
+        c->unacked = 0;
+        return;
+    }
+    
+    /* the chunk is copied straight from the frame to its destination */
+    for(i = 0; i < length; i++){
+        c->dest[offset + i] = view.data[CHUNK_HEADER_LEN + i];
+    }
+    c->expected += length;
+    c->unacked++;
+    
+    if(c->expected >= c->total){
+        sendChunkAck(c, c->expected);
+        c->expected = 0;
+        c->unacked = 0;
+        
+        if(c->doneFunctPtr != 0)
+            c->doneFunctPtr(c->total);
+    }else if(c->unacked >= DIS_CHUNK_WINDOW){
+        sendChunkAck(c, c->expected);
+        c->unacked = 0;
+    }
+}
+
+static void sendChunkAck(ChunkTransfer* c, uint16_t ack){
+    /* the latest acknowledgement covers any earlier one still pending */
+    c->ack = ack;
+    c->ackPending = (DIS_publish_u16(c->topic, &c->ack) == 0);
+}
+
+static uint16_t readVarint(const uint8_t* data, uint16_t* byteIndex, uint16_t bytes){
+    uint16_t index = *byteIndex;
+    uint16_t code = 0;
+    uint8_t shift = 0;
+    
+    /* no more than three bytes, the frame was checked for longer codes
+     * when it was received */
+    while((index < bytes) && (shift < 16)){
+        code |= ((uint16_t)data[index] & 0x7f) << shift;
+        shift += 7;
+        index++;
+        
+        if((data[index - 1] & 0x80) == 0)
+            break;
+    }
+    
+    *byteIndex = index;
+    
+    /* undo the zig-zag mapping */
+    return (code >> 1) ^ (~(code & 1) + 1);
+}
+
+static int32_t readFixedElement(const DispatchView* view, uint16_t index){
+    const uint8_t* data = view->data;
+    
+    /* the data is byte-aligned within the frame, so it is
+     * assembled one byte at a time */
+    switch(view->format){
+        case eNONE:
+        case eSTRING:
+        case eU8:
+            return (int32_t)data[index];
+        
+        case eS8:
+            return (int32_t)(int8_t)data[index];
+        
+        case eU16:
         case eS16:
         {
-            // typecast to a int
-            int16_t* data = (int16_t*)destArray;
+            uint16_t value = (uint16_t)data[index << 1];
+            value |= (uint16_t)data[(index << 1) + 1] << 8;
             
-            // copy data to destination array
-            i = 0;
-            while(i < rxMsg.length8bit){
-                uint16_t dataIndex = i >> 1;
-                data[dataIndex] = (int16_t)rxMsg.data[currentIndex + i];
-                i++;
-                data[dataIndex] |= (int16_t)rxMsg.data[currentIndex + i] << 8;
-                i++;
-            }
+            if(view->format == eS16)
+                return (int32_t)(int16_t)value;
             
-            break;
+            return (int32_t)value;
         }
         
-        case eU32:
+        case eU12:
+        case eS12:
         {
-            // typecast to a int
-            uint32_t* data = (uint32_t*)destArray;
+            uint16_t byteIndex = (index >> 1) * 3;
+            uint16_t value;
             
-            // copy data to destination array
-            i = 0;
-            while(i < rxMsg.length8bit){
-                uint16_t dataIndex = i >> 2;
-                data[dataIndex] = (uint32_t)rxMsg.data[currentIndex + i];
-                i++;
-                data[dataIndex] |= (uint32_t)rxMsg.data[currentIndex + i] << 8;
-                i++;
-                data[dataIndex] |= (uint32_t)rxMsg.data[currentIndex + i] << 16;
-                i++;
-                data[dataIndex] |= (uint32_t)rxMsg.data[currentIndex + i] << 24;
-                i++;
+            if((index & 1) == 0){
+                value = (uint16_t)data[byteIndex];
+                value |= ((uint16_t)data[byteIndex + 1] & 0x0f) << 8;
+            }else{
+                value = (uint16_t)data[byteIndex + 1] >> 4;
+                value |= (uint16_t)data[byteIndex + 2] << 4;
             }
             
-            break;
+            // sign extend the signed values
+            if((view->format == eS12) && (value & 0x0800)){
+                value |= 0xf000;
+                return (int32_t)(int16_t)value;
+            }
+            
+            return (int32_t)value;
         }
         
+        case eU32:
         case eS32:
         {
-            // typecast to a int
-            int32_t* data = (int32_t*)destArray;
+            uint32_t value = (uint32_t)data[index << 2];
+            value |= (uint32_t)data[(index << 2) + 1] << 8;
+            value |= (uint32_t)data[(index << 2) + 2] << 16;
+            value |= (uint32_t)data[(index << 2) + 3] << 24;
             
-            // copy data to destination array
-            i = 0;
-            while(i < rxMsg.length8bit){
-                uint16_t dataIndex = i >> 2;
-                data[dataIndex] = (int32_t)rxMsg.data[currentIndex + i];
-                i++;
-                data[dataIndex] |= (int32_t)rxMsg.data[currentIndex + i] << 8;
-                i++;
-                data[dataIndex] |= (int32_t)rxMsg.data[currentIndex + i] << 16;
-                i++;
-                data[dataIndex] |= (int32_t)rxMsg.data[currentIndex + i] << 24;
-                i++;
-            }
-            break;
+            return (int32_t)value;
         }
+        
+        default:
+            return 0;
     }
-    
-    return rxMsg.length;
 }
 
-uint16_t getCurrentRxPointerIndex(uint8_t element){
-    uint16_t i = 0;
-    uint16_t currentIndex = 0;
-    
-    for(i = 0; i < element; i++){
-        uint16_t widthInBytes = 0;
-        if((rxMsg.formatSpecifiers[i] == eNONE)
-                || (rxMsg.formatSpecifiers[i] == eU8)
-                || (rxMsg.formatSpecifiers[i] == eS8)){
-            widthInBytes = 1;
-        }else if((rxMsg.formatSpecifiers[i] == eU16)
-                || (rxMsg.formatSpecifiers[i] == eS16)){
-            widthInBytes = 2;
-        }else{
-            widthInBytes = 4;
-        }
-        
-        currentIndex += rxMsg.length * widthInBytes;
-    }
-    
-    return currentIndex;
+void DIS_getFrameStats(FrameStats* stats){
+    FRM_getStats(stats);
+}
+
+void DIS_resetFrameStats(void){
+    FRM_resetStats();
+}
+
+uint16_t DIS_staticBytes(void){
+    return sizeof(rxMsg) + ARENA_regionBytes(ARENA_MESSAGE)
+            + sizeof(sub) + sizeof(conflation) + sizeof(pub)
+            + sizeof(chunks) + sizeof(slice) + sizeof(pubTopic)
+            + FRM_staticBytes();
 }
 
 void DIS_assignChannelReadable(uint16_t (*functPtr)()){
@@ -889,10 +1995,22 @@ void DIS_assignChannelWriteable(uint16_t (*functPtr)()){
     FRM_assignChannelWriteable(functPtr);
 }
 
+void DIS_assignChannelSendable(uint16_t (*functPtr)()){
+    FRM_assignChannelSendable(functPtr);
+}
+
 void DIS_assignChannelRead(void (*functPtr)(uint8_t* data, uint16_t length)){
     FRM_assignChannelRead(functPtr);
 }
 
 void DIS_assignChannelWrite(void (*functPtr)(uint8_t* data, uint16_t length)){
     FRM_assignChannelWrite(functPtr);
+}
+
+void DIS_assignChannelHold(void (*functPtr)()){
+    FRM_assignChannelHold(functPtr);
+}
+
+void DIS_assignChannelRelease(void (*functPtr)(uint8_t data)){
+    FRM_assignChannelRelease(functPtr);
 }
\ No newline at end of file
@@ -3,6 +3,31 @@
 
 #include <stdint.h>
 #include "dispatch_config.h"
+#include "frame.h"
+
+/** The format of each dimension of a message */
+typedef enum formatspecifier{
+    eNONE = 0,
+    eSTRING = 1,
+    eU8 = 2,
+    eS8 = 3,
+    eU16 = 4,
+    eS16 = 5,
+    eU32 = 6,
+    eS32 = 7,
+    eU12 = 8,
+    eS12 = 9,
+    eD16 = 10
+}FormatSpecifier;
+
+/** A view of one dimension of the received message, pointing
+ * directly into the received frame */
+typedef struct{
+    const uint8_t* data;
+    uint16_t count;
+    uint16_t bytes;
+    FormatSpecifier format;
+}DispatchView;
 
 /**
  * Initializes the PUB library elements, must be called before
@@ -17,8 +42,10 @@ void DIS_init(void);
  * and format specifiers
  * 
  * @param ... one or more pointers to the data arrays
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
  */
-void DIS_publish(const char* topic, ...);
+uint8_t DIS_publish(const char* topic, ...);
 
 /**
  * Publish a string to a particular topic
@@ -26,8 +53,25 @@ void DIS_publish(const char* topic, ...);
  * @param topic a text string that contains the topic and length
  * 
  * @param str string pointer
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
+ */
+uint8_t DIS_publish_str(const char* topic, char* str);
+
+/**
+ * Publish a set of single-element fields as one multi-dimension frame.
+ * Only the fields selected by 'mask' are sent.  The first dimension
+ * is always a u8 containing the mask of the fields that follow so that
+ * the receiver can tell which fields are present.
+ * 
+ * @param topic a text string that contains the topic followed by one
+ * format specifier for each field, i.e. "status,u16,s16,u8"
+ * @param mask bit 'n' is set when field 'n' is to be sent
+ * @param fields array of pointers to each field, in topic string order
+ * @return the mask of the fields that were actually sent, 0 if the
+ * frame was not sent
  */
-void DIS_publish_str(const char* topic, char* str);
+uint8_t DIS_publish_fields(const char* topic, uint8_t mask, void** fields);
 
 /**
  * Publish data to a particular topic
@@ -35,8 +79,10 @@ void DIS_publish_str(const char* topic, char* str);
  * @param topic a text string that contains the topic and length
  * 
  * @param data pointer to the first element in the array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
  */
-void DIS_publish_u8(const char* topic, uint8_t* data);
+uint8_t DIS_publish_u8(const char* topic, uint8_t* data);
 
 /**
  * Publish data to a particular topic
@@ -44,8 +90,10 @@ void DIS_publish_u8(const char* topic, uint8_t* data);
  * @param topic a text string that contains the topic and length
  * 
  * @param data pointer to the first element in the array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
  */
-void DIS_publish_s8(const char* topic, int8_t* data);
+uint8_t DIS_publish_s8(const char* topic, int8_t* data);
 
 /**
  * Publish data to a particular topic
@@ -54,8 +102,10 @@ void DIS_publish_s8(const char* topic, int8_t* data);
  * 
  * @param data0 pointer to the first element in the first array
  * @param data1 pointer to the first element in the second array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
  */
-void DIS_publish_2u8(const char* topic, uint8_t* data0, uint8_t* data1);
+uint8_t DIS_publish_2u8(const char* topic, uint8_t* data0, uint8_t* data1);
 
 /**
  * Publish data to a particular topic
@@ -64,8 +114,10 @@ void DIS_publish_2u8(const char* topic, uint8_t* data0, uint8_t* data1);
  * 
  * @param data0 pointer to the first element in the first array
  * @param data1 pointer to the first element in the second array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
  */
-void DIS_publish_2s8(const char* topic, int8_t* data0, int8_t* data1);
+uint8_t DIS_publish_2s8(const char* topic, int8_t* data0, int8_t* data1);
 
 /**
  * Publish data to a particular topic
@@ -73,8 +125,10 @@ void DIS_publish_2s8(const char* topic, int8_t* data0, int8_t* data1);
  * @param topic a text string that contains the topic and length
  * 
  * @param data pointer to the first element in the array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
  */
-void DIS_publish_u16(const char* topic, uint16_t* data);
+uint8_t DIS_publish_u16(const char* topic, uint16_t* data);
 
 /**
  * Publish data to a particular topic
@@ -82,8 +136,10 @@ void DIS_publish_u16(const char* topic, uint16_t* data);
  * @param topic a text string that contains the topic and length
  * 
  * @param data pointer to the first element in the array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
  */
-void DIS_publish_s16(const char* topic, int16_t* data);
+uint8_t DIS_publish_s16(const char* topic, int16_t* data);
 
 /**
  * Publish data to a particular topic
@@ -92,8 +148,10 @@ void DIS_publish_s16(const char* topic, int16_t* data);
  * 
  * @param data0 pointer to the first element in the first array
  * @param data1 pointer to the first element in the second array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
  */
-void DIS_publish_2u16(const char* topic, uint16_t* data0, uint16_t* data1);
+uint8_t DIS_publish_2u16(const char* topic, uint16_t* data0, uint16_t* data1);
 
 /**
  * Publish data to a particular topic
@@ -102,8 +160,71 @@ void DIS_publish_2u16(const char* topic, uint16_t* data0, uint16_t* data1);
  * 
  * @param data0 pointer to the first element in the first array
  * @param data1 pointer to the first element in the second array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
+ */
+uint8_t DIS_publish_2s16(const char* topic, int16_t* data0, int16_t* data1);
+
+/**
+ * Publish data to a particular topic, packing each pair of 12-bit
+ * values into three bytes.  Only the low 12 bits of each value are
+ * sent; the receiver sign-extends them.
+ * 
+ * @param topic a text string that contains the topic and length
+ * 
+ * @param data0 pointer to the first element in the first array
+ * @param data1 pointer to the first element in the second array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
+ */
+uint8_t DIS_publish_2s12(const char* topic, int16_t* data0, int16_t* data1);
+
+/**
+ * Publish data to a particular topic, coding each array as the
+ * difference from the previous element, zig-zag mapped and sent as a
+ * variable number of bytes.  Arrays that change slowly from element to
+ * element, such as a swept curve, are sent in fewer bytes.
+ * 
+ * @param topic a text string that contains the topic and length
+ * 
+ * @param data0 pointer to the first element in the first array
+ * @param data1 pointer to the first element in the second array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
+ */
+uint8_t DIS_publish_2d16(const char* topic, int16_t* data0, int16_t* data1);
+
+/**
+ * Begin publishing two arrays to a particular topic, to be sent a slice
+ * at a time by DIS_publishSlice() so that a long frame doesn't hold up
+ * the caller.  The arrays must not change until the frame is complete.
+ * Any other publish is dropped, counting against a conflated topic,
+ * until the frame is complete; publishers scheduled with
+ * DIS_schedulePublisher() should check DIS_isPublishing() and retry.
+ * 
+ * @param topic a text string that contains the topic and length
+ * @param format the format of both arrays, eS16, eS12 or eD16
+ * @param data0 pointer to the first element in the first array
+ * @param data1 pointer to the first element in the second array
+ * @return non-zero if the publish was begun, 0 if it was dropped
  */
-void DIS_publish_2s16(const char* topic, int16_t* data0, int16_t* data1);
+uint8_t DIS_publishArraysBegin(const char* topic, FormatSpecifier format,
+        int16_t* data0, int16_t* data1);
+
+/**
+ * Send the next slice of the publish begun by DIS_publishArraysBegin().
+ * A slice is never more than the channel takes without waiting.
+ * 
+ * @param budget the maximum number of bytes to push
+ * @return non-zero once the frame is complete, or if there is none
+ */
+uint8_t DIS_publishSlice(uint16_t budget);
+
+/**
+ * @return non-zero while a publish begun by DIS_publishArraysBegin()
+ * is incomplete, while other publishes are dropped
+ */
+uint8_t DIS_isPublishing(void);
 
 /**
  * Publish data to a particular topic
@@ -111,8 +232,10 @@ void DIS_publish_2s16(const char* topic, int16_t* data0, int16_t* data1);
  * @param topic a text string that contains the topic and length
  * 
  * @param data pointer to the first element in the array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
  */
-void DIS_publish_u32(const char* topic, uint32_t* data);
+uint8_t DIS_publish_u32(const char* topic, uint32_t* data);
 
 /**
  * Publish data to a particular topic
@@ -120,19 +243,126 @@ void DIS_publish_u32(const char* topic, uint32_t* data);
  * @param topic a text string that contains the topic and length
  * 
  * @param data pointer to the first element in the array
+ * 
+ * @return non-zero if the frame was sent, 0 if it was dropped
+ */
+uint8_t DIS_publish_s32(const char* topic, int32_t* data);
+
+/**
+ * Place a topic into conflating publish mode.  While the last frame
+ * published to the topic is still queued in the channel, newer
+ * publishes to the same topic are dropped instead of being queued
+ * behind it.  The next publish after the channel drains carries the
+ * freshest value, so latency stays bounded when the link is congested.
+ * 
+ * @param topic a text string that contains the topic; any length and
+ * format specifiers are ignored.  The string must remain valid for as
+ * long as the topic is conflated.
+ */
+void DIS_conflate(const char* topic);
+
+/**
+ * Returns the number of publishes dropped on a conflated topic
+ * 
+ * @param topic a text string that contains the topic
+ * @return the drop count, or 0 if the topic is not conflated
+ */
+uint16_t DIS_getDropCount(const char* topic);
+
+/**
+ * Register a published topic so that it is assigned a topic id.  When
+ * the host sends the "topics" topic, the device answers on "topics"
+ * with a comma-separated list of topic names whose position in the
+ * list is the topic id: subscriptions first, then registered topics.
+ * From then on, registered topics are sent with the id alone, and
+ * the host must address the subscriptions by id; a message sent by topic
+ * string is taken to be from a host that doesn't know the ids, and the
+ * device goes back to sending the names.  Topics that are not registered
+ * are always sent by name.
+ * 
+ * @param topic a text string that contains the topic; any length and
+ * format specifiers are ignored.  The string must remain valid.
+ */
+void DIS_registerTopic(const char* topic);
+
+/**
+ * Schedule a publisher to be executed by DIS_managePublishers().  The
+ * publisher is executed as soon as it is flagged with DIS_notifyChanged()
+ * and otherwise only once every 'keepalive' ms.
+ * 
+ * @param functPtr the publishing function; its argument is non-zero when
+ * it is executed for a keepalive, in which case it should send everything
+ * rather than only what changed.  It returns non-zero when all it wanted
+ * to send actually went out, otherwise it is executed again on the next
+ * call to DIS_managePublishers().
+ * @param keepalive the ms between keepalives, measured with TASK_getTime()
  */
-void DIS_publish_s32(const char* topic, int32_t* data);
+void DIS_schedulePublisher(uint8_t (*functPtr)(uint8_t keepalive), uint16_t keepalive);
+
+/**
+ * Flag a scheduled publisher so that it is executed on the next call to
+ * DIS_managePublishers().  Call whenever the value(s) backing the
+ * publisher change.
+ * 
+ * @param functPtr the publishing function given to DIS_schedulePublisher()
+ */
+void DIS_notifyChanged(uint8_t (*functPtr)(uint8_t keepalive));
+
+/**
+ * This function must be called periodically in order to execute the
+ * scheduled publishers.  The keepalive intervals are measured in ms,
+ * so a keepalive is late by at most the time between calls.
+ */
+void DIS_managePublishers(void);
 
 /**
  * Subscribe to a particular topic
  * 
- * @param topic a text string that contains the topic only
+ * @param topic a text string that contains the topic only; the string is
+ * referenced rather than copied, so it must outlive the subscription, as a
+ * string literal does
  * 
  * @param functPtr a function pointer to the function that should
  * be executed when the particular topic is received.
  */
 void DIS_subscribe(const char* topic, void (*functPtr)());
 
+/**
+ * Receive messages larger than a single frame on a topic.  The host
+ * sends the message as a series of chunks, each a single u8 dimension
+ * made up of the u16 offset of the chunk, the u16 total length of the
+ * message, then the chunk data.  Chunks must arrive in order; each one
+ * is copied directly into 'dest'.
+ * 
+ * The device acknowledges on the same topic with a u16 holding the
+ * number of bytes received in order so far, every DIS_CHUNK_WINDOW
+ * chunks, on completion, and whenever a chunk is out of order.  The
+ * host may have up to DIS_CHUNK_WINDOW chunks unacknowledged and
+ * resends from the acknowledged offset when it falls behind.  An
+ * acknowledgement of 0xffff refuses a message that does not fit.  A
+ * chunk at offset 0 always restarts the transfer.  An acknowledgement
+ * that is dropped, for want of credits or during a sliced publish, is
+ * sent again by DIS_managePublishers().
+ * 
+ * Each chunk is a received message, so it is limited by
+ * MAX_RECEIVE_MESSAGE_LEN: with the defaults, up to 53 data bytes with
+ * a topic id, less the length of the name with a named topic.  The host
+ * must also keep each framed chunk, escapes included, within
+ * RX_FRAME_LENGTH, or the chunk is never received.
+ * 
+ * Uses one subscription.
+ * 
+ * @param topic a text string that contains the topic only; the string
+ * must remain valid
+ * @param dest the destination buffer
+ * @param maxLength the length of the destination buffer
+ * @param doneFunctPtr executed with the message length when the last
+ * chunk is received; 'dest' may be overwritten by the next transfer
+ * once it returns
+ */
+void DIS_receiveChunks(const char* topic, uint8_t* dest, uint16_t maxLength,
+        void (*doneFunctPtr)(uint16_t length));
+
 /**
  * Unsubscribe the function from all topics
  * 
@@ -162,9 +392,60 @@ void DIS_process(void);
  * @param element the element number
  * @param destArray the destination array for the data to be copied
  * into
- * @return the length of the received data
+ * @param maxElements the number of elements that destArray holds
+ * @return the number of elements copied, no more than maxElements
+ */
+uint16_t DIS_getElements(uint16_t element, void* destArray, uint16_t maxElements);
+
+/**
+ * The subscribing function(s) may use this function to look at the
+ * received data in place rather than copying it out.  The view is
+ * valid until the subscribing function returns.
+ * 
+ * @param element the element number
+ * @param view the view to fill in
+ * @return the number of values in the element, 0 if there is no
+ * such element
+ */
+uint16_t DIS_getView(uint16_t element, DispatchView* view);
+
+/**
+ * Returns a single value from a view, converted according to the
+ * format of the view.  Delta-coded values are decoded from the start
+ * of the view, so use DIS_getElements() to read all of them.
+ * 
+ * @param view a view filled in by DIS_getView()
+ * @param index the index of the value within the view
+ * @return the value, or 0 if the index is out of range
  */
-uint16_t DIS_getElements(uint16_t element, void* destArray);
+int32_t DIS_viewElement(const DispatchView* view, uint16_t index);
+
+/**
+ * Returns the first value of an element, for subscribing functions
+ * which only expect a single value.
+ * 
+ * @param element the element number
+ * @return the value, or 0 if there is no such element
+ */
+int32_t DIS_getScalar(uint16_t element);
+
+/**
+ * Copies the frame counters of the communication channel
+ * 
+ * @param stats the destination for the counters
+ */
+void DIS_getFrameStats(FrameStats* stats);
+
+/**
+ * Clears the frame counters of the communication channel
+ */
+void DIS_resetFrameStats(void);
+
+/**
+ * @return the RAM taken by the dispatch and frame modules' variables,
+ * in bytes
+ */
+uint16_t DIS_staticBytes(void);
 
 /** 
  * Use this function to assign the 'readable' function.  The 
@@ -182,9 +463,21 @@ void DIS_assignChannelReadable(uint16_t (*functPtr)());
  * 
  * @param *functPtr a function pointer for a function that will
  * return the number of bytes that are able to be written to
- * the communication channel */
+ * the communication channel; assign it while the channel is still
+ * empty, since its capacity is taken from the first call */
 void DIS_assignChannelWriteable(uint16_t (*functPtr)());
 
+/** 
+ * Use this function to assign the 'sendable' function.  The
+ * 'sendable' function must return a uint16_t and take a void.
+ * Optional; once assigned, a frame that might not be sent in full
+ * is dropped whole and counted in FrameStats.txDropped.
+ * 
+ * @param *functPtr a function pointer for a function that will
+ * return the number of bytes that, once written, will be sent
+ * without waiting on flow control, or 0xffff for no limit */
+void DIS_assignChannelSendable(uint16_t (*functPtr)());
+
 /** 
  * Use this function to assign the 'read' function.  The 'read'
  * function must take a data pointer and a length.  This allows
@@ -205,4 +498,24 @@ void DIS_assignChannelRead(void (*functPtr)(uint8_t* data, uint16_t length));
  * write <length> data from <data> to the outgoing buffer */
 void DIS_assignChannelWrite(void (*functPtr)(uint8_t* data, uint16_t length));
 
+/** 
+ * Use this function to assign the 'hold' function, required with
+ * FRAMING_COBS.  The 'hold' function takes a void.  The next byte
+ * written to the outgoing channel buffer, and every byte after it,
+ * must wait there until the 'release' function is called.
+ * 
+ * @param *functPtr a function pointer for a function that will
+ * hold the outgoing data from the next byte written */
+void DIS_assignChannelHold(void (*functPtr)());
+
+/** 
+ * Use this function to assign the 'release' function, required with
+ * FRAMING_COBS.  The 'release' function takes a byte, which replaces
+ * the first held byte before the held bytes are sent.  This lets a
+ * COBS block wait in the channel buffer until its code byte is known.
+ * 
+ * @param *functPtr a function pointer for a function that will
+ * replace the held byte with <data> and send the held data */
+void DIS_assignChannelRelease(void (*functPtr)(uint8_t data));
+
 #endif
@@ -2,19 +2,49 @@
 #define	DISPATCH_CONFIG_H
 
 /** The max number of dimensions that will be utilized */
-#define MAX_NUM_OF_FORMAT_SPECIFIERS    4
+#define MAX_NUM_OF_FORMAT_SPECIFIERS    6
 
 /** The maximum number of subscriptions that will be utilized */
-#define MAX_NUM_OF_SUBSCRIPTIONS        6
+#define MAX_NUM_OF_SUBSCRIPTIONS        9
 
-/** The maximum topic string length */
+/** The maximum number of published topics that may be assigned topic ids */
+#define MAX_NUM_OF_PUBLISHED_TOPICS     9
+
+/** The maximum number of topics that may be placed in conflating mode */
+#define MAX_NUM_OF_CONFLATED_TOPICS     6
+
+/** The maximum number of publishers that may be scheduled: the status,
+ * stats and mem, and the task and interrupt statistics in debug builds */
+#define MAX_NUM_OF_PUBLISHERS           5
+
+/** The maximum number of topics that may receive chunked transfers */
+#define MAX_NUM_OF_CHUNKED_TOPICS       1
+
+/** The number of chunks received between acknowledgements of a chunked
+ * transfer; the host may have this many chunks in flight */
+#define DIS_CHUNK_WINDOW                4
+
+/** The maximum length of a received topic string */
 #define MAX_TOPIC_STR_LEN               16
 
-/** The maximum receive message length */
-#define MAX_RECEIVE_MESSAGE_LEN         32
+/** The maximum receive message length, the checksum included; a chunk
+ * of a chunked transfer carries up to 53 data bytes with a topic id */
+#define MAX_RECEIVE_MESSAGE_LEN         64
+
+/** The received frame length, room for a whole message and some escapes */
+#define RX_FRAME_LENGTH 96
+
+/** The framing options, selected using FRAMING_MODE:
+ *  FRAMING_ESCAPE - start and end of frame bytes, with escape sequences
+ *                   for those bytes in the data (up to 2x the data size)
+ *  FRAMING_COBS   - consistent overhead byte stuffing between zero
+ *                   delimiters (1 byte per 254 bytes); each block waits
+ *                   in the channel until its code byte is known, which
+ *                   needs a TX_BUF_LENGTH of at least 256 */
+#define FRAMING_ESCAPE  0
+#define FRAMING_COBS    1
 
-/** The received frame length */
-#define RX_FRAME_LENGTH 64
+#define FRAMING_MODE    FRAMING_ESCAPE
 
 #endif	/* DISPATCH_CONFIG_H */
 
@@ -1,4 +1,6 @@
 #include "frame.h"
+#include "trace.h"
+#include "arena.h"
 #include <stddef.h>
 
 #define START_OF_FRAME 0xf7
@@ -6,27 +8,101 @@
 #define ESC 0xf6
 #define ESC_XOR 0x20
 
-static uint8_t rxFrame[RX_FRAME_LENGTH];
+#define COBS_DELIMITER 0x00
+
+/* standard COBS: only a code of 0xff, a full block, has no implied zero */
+#define COBS_MAX_CODE 0xff
+
+/* the current block waits in the channel until its code byte is known, so
+ * the channel must take the largest block and its code byte */
+#if (FRAMING_MODE == FRAMING_COBS) && (TX_BUF_LENGTH < (COBS_MAX_CODE + 1))
+#error "COBS framing needs a TX_BUF_LENGTH of at least 256 bytes"
+#endif
+
+static uint8_t* rxFrame;
 static uint16_t rxFrameIndex = 0;
 
+#if FRAMING_MODE == FRAMING_COBS
+/* the current COBS block is held in the channel behind a placeholder for
+ * its code byte, which is filled in once the block ends */
+static uint16_t cobsLength = 0;
+static uint8_t cobsBlockOpen = 0;
+#endif
+
 static uint16_t f16Sum1 = 0, f16Sum2 = 0;
 
+/* running count of bytes handed to the channel and the channel capacity,
+ * taken when the channel is assigned while it is still empty; the largest
+ * 'writeable' value seen since also counts, in case it wasn't */
+static uint16_t txByteCount = 0;
+static uint16_t channelCapacity = 0;
+
+/* set while a dropped frame is being pushed */
+static uint8_t discarding = 0;
+
+static FrameStats stats = {0};
+
 static void FRM_pushToChannel(uint8_t data);
+static void FRM_writeToChannel(uint8_t data);
+#if FRAMING_MODE == FRAMING_COBS
+static void FRM_startBlock(void);
+static void FRM_endBlock(uint8_t code);
+static bool FRM_onlyBlockQueued(uint16_t writeable);
+static uint16_t FRM_cobsDecode(uint8_t* src, uint16_t length, uint8_t* data);
+#endif
 static uint16_t FRM_fletcher16(uint8_t* data, size_t bytes);
+static uint32_t FRM_framedBytes(uint16_t length);
 
 uint16_t (*channelReadableFunctPtr)();
 uint16_t (*channelWriteableFunctPtr)();
+uint16_t (*channelSendableFunctPtr)();
 void (*channelReadFunctPtr)(uint8_t* data, uint16_t length);
 void (*channelWriteFunctPtr)(uint8_t* data, uint16_t length);
+void (*channelHoldFunctPtr)();
+void (*channelReleaseFunctPtr)(uint8_t data);
+
+void FRM_initReceive(void){
+    rxFrame = ARENA_region(ARENA_FRAME_RX);
+    rxFrameIndex = 0;
+}
 
-void FRM_init(void){
-    uint8_t dataToSend = START_OF_FRAME;
-    channelWriteFunctPtr(&dataToSend, 1);
+uint8_t FRM_init(uint16_t length){
+    uint16_t sendable = 0xffff;
+    
+    if(channelSendableFunctPtr != 0)
+        sendable = channelSendableFunctPtr();
+    
+    /* a frame left waiting part way through for credits would hold up
+     * every frame behind it, so it isn't started at all; 0xffff is no limit */
+    if((sendable != 0xffff) && (FRM_framedBytes(length) > sendable)){
+        discarding = 1;
+        stats.txDropped++;
+        return 0;
+    }
+    
+    discarding = 0;
+    
+#if FRAMING_MODE == FRAMING_COBS
+    /* a block left open would stop the channel for good */
+    if(cobsBlockOpen)
+        FRM_endBlock(cobsLength + 1);
+    
+    /* a leading delimiter resynchronizes the receiver */
+    FRM_writeToChannel(COBS_DELIMITER);
+    FRM_startBlock();
+#else
+    FRM_writeToChannel(START_OF_FRAME);
+#endif
     
     f16Sum1 = f16Sum2 = 0;
+    
+    return 1;
 }
 
 void FRM_push(uint8_t data){
+    if(discarding)
+        return;
+    
     FRM_pushToChannel(data);
         
     f16Sum1 = (f16Sum1 + (uint16_t)data) & 0xff;
@@ -34,121 +110,358 @@ void FRM_push(uint8_t data){
 }
 
 void FRM_finish(void){
-    uint8_t dataToSend = END_OF_FRAME;
+    if(discarding)
+        return;
     
     FRM_pushToChannel(f16Sum1);
     FRM_pushToChannel(f16Sum2);
     
-    channelWriteFunctPtr(&dataToSend, 1);
+#if FRAMING_MODE == FRAMING_COBS
+    /* the last block never has an implied zero */
+    FRM_endBlock(cobsLength + 1);
+    FRM_writeToChannel(COBS_DELIMITER);
+#else
+    FRM_writeToChannel(END_OF_FRAME);
+#endif
+    
+    stats.txFrames++;
+    TRACE(TRACE_FRAME_TX, 0);
+}
+
+void FRM_getStats(FrameStats* dest){
+    *dest = stats;
+}
+
+void FRM_resetStats(void){
+    stats.txFrames = 0;
+    stats.rxFrames = 0;
+    stats.rxErrors = 0;
+    stats.txDropped = 0;
+}
+
+uint16_t FRM_staticBytes(void){
+    return ARENA_regionBytes(ARENA_FRAME_RX) + sizeof(stats);
+}
+
+uint16_t FRM_writeable(void){
+    return channelWriteableFunctPtr();
+}
+
+uint16_t FRM_pushable(void){
+    uint16_t writeable = channelWriteableFunctPtr();
+    
+#if FRAMING_MODE == FRAMING_COBS
+    uint16_t toFill = (COBS_MAX_CODE - 1) - cobsLength;
+    uint16_t pushable = 0;
+    
+    /* each byte pushed takes one byte, a data byte or the code byte of the
+     * block that a zero starts, and each block filled one more */
+    if(writeable > 0)
+        pushable = (writeable - 1) - ((writeable - 1) / (COBS_MAX_CODE - 1));
+    
+    /* no room comes free while the open block is all that the channel
+     * holds, until the block is filled and sent: the bytes that fill it
+     * always fit, and two more wait on it going out, a byte time each */
+    if(FRM_onlyBlockQueued(writeable) && (pushable < (toFill + 2)))
+        pushable = toFill + 2;
+    
+    return pushable;
+#else
+    return writeable >> 1;
+#endif
+}
+
+uint16_t FRM_finishBytes(void){
+#if FRAMING_MODE == FRAMING_COBS
+    /* the checksum, the code byte of a block that it fills, and the
+     * delimiter; the held block is already in the channel.  Beside a
+     * block that leaves less room than that, the bytes past the block
+     * wait on it going out */
+    uint16_t bytes = 2 + 1 + 1;
+    uint16_t writeable = channelWriteableFunctPtr();
+    
+    if(FRM_onlyBlockQueued(writeable) && (writeable < bytes))
+        bytes = writeable;
+    
+    return bytes;
+#else
+    /* the checksum, escaped, and the end of frame */
+    return (2 * 2) + 1;
+#endif
+}
+
+uint16_t FRM_txMarker(void){
+    return txByteCount;
 }
 
+bool FRM_isQueued(uint16_t marker){
+    uint16_t writeable = channelWriteableFunctPtr();
+    uint16_t queued, writtenSince;
+    
+    if(writeable > channelCapacity)
+        channelCapacity = writeable;
+    
+    /* the frame ending at 'marker' is still in the channel if there are more
+     * bytes waiting to go out than have been written since the marker */
+    queued = channelCapacity - writeable;
+    writtenSince = txByteCount - marker;
+    
+    return (queued > writtenSince);
+}
+
+#if FRAMING_MODE == FRAMING_COBS
+void FRM_pushToChannel(uint8_t data){
+    /* each zero ends a block; its code byte is the distance to the zero */
+    if(data == 0){
+        FRM_endBlock(cobsLength + 1);
+        FRM_startBlock();
+    }else{
+        FRM_writeToChannel(data);
+        cobsLength++;
+        
+        /* a full block has no implied zero */
+        if(cobsLength >= (COBS_MAX_CODE - 1)){
+            FRM_endBlock(COBS_MAX_CODE);
+            FRM_startBlock();
+        }
+    }
+}
+
+void FRM_startBlock(void){
+    /* the channel sends nothing from the placeholder on until released */
+    channelHoldFunctPtr();
+    FRM_writeToChannel(0);
+    cobsLength = 0;
+    cobsBlockOpen = 1;
+}
+
+void FRM_endBlock(uint8_t code){
+    channelReleaseFunctPtr(code);
+    cobsBlockOpen = 0;
+}
+
+bool FRM_onlyBlockQueued(uint16_t writeable){
+    /* nothing else is left to drain from the channel */
+    return cobsBlockOpen && ((channelCapacity - writeable) <= (cobsLength + 1));
+}
+#else
 void FRM_pushToChannel(uint8_t data){
     /* add proper escape sequences */
     if((data == START_OF_FRAME) || (data == END_OF_FRAME) || (data == ESC)){
-        uint8_t escChar = ESC;
-        uint8_t escData = data ^ ESC_XOR;
-        channelWriteFunctPtr(&escChar, 1);
-        channelWriteFunctPtr(&escData, 1);
+        FRM_writeToChannel(ESC);
+        FRM_writeToChannel(data ^ ESC_XOR);
     }else{
-        channelWriteFunctPtr(&data, 1);
+        FRM_writeToChannel(data);
     }
 }
+#endif
 
-uint16_t FRM_pull(uint8_t* data){
-    uint16_t sofIndex = 0, eofIndex = 0;
-    uint16_t length = 0;
+uint32_t FRM_framedBytes(uint16_t length){
+    /* the worst case for 'length' bytes and the checksum */
+    uint32_t bytes = (uint32_t)length + 2;
     
-    uint16_t i = 0;
+#if FRAMING_MODE == FRAMING_COBS
+    /* a code byte for every block and the delimiters at each end */
+    return bytes + (bytes / (COBS_MAX_CODE - 1)) + 1 + 2;
+#else
+    /* every byte escaped and the start and end of frame */
+    return (bytes << 1) + 2;
+#endif
+}
+
+void FRM_writeToChannel(uint8_t data){
+    channelWriteFunctPtr(&data, 1);
+    txByteCount++;
+}
+
+#if FRAMING_MODE == FRAMING_COBS
+uint16_t FRM_pull(uint8_t* data){
+    uint16_t eofIndex = 0, length = 0;
+    uint16_t i;
     
     /* read the available bytes into the rxFrame */
     uint16_t numOfBytes = channelReadableFunctPtr();
+    if(numOfBytes > (RX_FRAME_LENGTH - rxFrameIndex))
+        numOfBytes = RX_FRAME_LENGTH - rxFrameIndex;
     channelReadFunctPtr(&rxFrame[rxFrameIndex], numOfBytes);
     rxFrameIndex += numOfBytes;
     
-    /* find the START_OF_FRAME */
-    while(i < RX_FRAME_LENGTH){
-        if(rxFrame[i] == START_OF_FRAME){
-            sofIndex = i;
-            break;
-        }else{
-            rxFrame[i] = 0; /* clear the byte that isn't the START_OF_FRAME */
-        }
-        i++;
+    /* skip any delimiters between frames */
+    while((eofIndex < rxFrameIndex) && (rxFrame[eofIndex] == COBS_DELIMITER)){
+        eofIndex++;
+    }
+    for(i = 0; (i + eofIndex) < rxFrameIndex; i++){
+        rxFrame[i] = rxFrame[i + eofIndex];
     }
+    rxFrameIndex -= eofIndex;
     
-    /* find the END_OF_FRAME */
-    i = sofIndex;
-    while(i < RX_FRAME_LENGTH){
-        if(rxFrame[i] == END_OF_FRAME){
-            eofIndex = i;
-            break;
+    /* find the delimiter at the end of the frame */
+    eofIndex = 0;
+    while((eofIndex < rxFrameIndex) && (rxFrame[eofIndex] != COBS_DELIMITER)){
+        eofIndex++;
+    }
+    
+    if(eofIndex >= rxFrameIndex){
+        /* a frame that fills the buffer without a delimiter can never
+         * complete, so drop it and wait for the next delimiter */
+        if(rxFrameIndex >= RX_FRAME_LENGTH)
+            rxFrameIndex = 0;
+        
+        return 0;
+    }
+    
+    length = FRM_cobsDecode(rxFrame, eofIndex, data);
+    
+    /* copy the remainder forward in preparation for the next frame */
+    eofIndex++;
+    for(i = 0; (i + eofIndex) < rxFrameIndex; i++){
+        rxFrame[i] = rxFrame[i + eofIndex];
+    }
+    rxFrameIndex -= eofIndex;
+    
+    /* check the data integrity using the last two bytes as
+     * the fletcher16 checksum */
+    if(length > 2){
+        uint16_t checksum = data[length - 2] | (data[length - 1] << 8);
+        length -= 2;
+        if(FRM_fletcher16(data, length) != checksum){
+            length = 0;
         }
-        i++;
+    }else{
+        length = 0;
     }
     
-    /* ensure that the start of frame and the end of frame are both present */
-    if(((rxFrame[0] == START_OF_FRAME) || (sofIndex > 0)) && (eofIndex != 0)){
-        int16_t frameIndex = sofIndex;
-        uint16_t checksum;
-        uint16_t check;
+    if(length > 0){
+        stats.rxFrames++;
+        TRACE(TRACE_FRAME_RX, (length > 0xff) ? 0xff : length);
+    }else{
+        stats.rxErrors++;
+        TRACE(TRACE_FRAME_ERROR, 0);
+        TRACE_trigger(TRACE_REASON_FRAME_ERROR);
+    }
+    
+    return length;
+}
+
+uint16_t FRM_cobsDecode(uint8_t* src, uint16_t length, uint8_t* data){
+    uint16_t srcIndex = 0, dataIndex = 0;
+    
+    while(srcIndex < length){
+        uint8_t code = src[srcIndex];
+        uint8_t j;
+        srcIndex++;
         
-        /* extract the received frame and shift the remainder of the
-         * bytes into the beginning of the frame */
-        i = 0;
+        for(j = 1; j < code; j++){
+            if((srcIndex >= length) || (dataIndex >= MAX_RECEIVE_MESSAGE_LEN))
+                return 0;
+            
+            data[dataIndex] = src[srcIndex];
+            dataIndex++;
+            srcIndex++;
+        }
         
-        rxFrame[frameIndex] = 0;
-        frameIndex++;
-        while(frameIndex < eofIndex){
-            if(rxFrame[frameIndex] == ESC){
-                frameIndex++;
-                data[i] = rxFrame[frameIndex] ^ ESC_XOR;
-            }else{
-                data[i] = rxFrame[frameIndex];
-            }
-            i++;
-            frameIndex++;
+        /* every block but a full one and the last one implies a zero */
+        if((code < COBS_MAX_CODE) && (srcIndex < length)){
+            if(dataIndex >= MAX_RECEIVE_MESSAGE_LEN)
+                return 0;
+            
+            data[dataIndex] = 0;
+            dataIndex++;
+        }
+    }
+    
+    return dataIndex;
+}
+#else
+uint16_t FRM_pull(uint8_t* data){
+    uint16_t sofIndex = 0, eofIndex = 0;
+    uint16_t length = 0;
+    uint16_t i;
+    
+    /* read the available bytes into the rxFrame */
+    uint16_t numOfBytes = channelReadableFunctPtr();
+    if(numOfBytes > (RX_FRAME_LENGTH - rxFrameIndex))
+        numOfBytes = RX_FRAME_LENGTH - rxFrameIndex;
+    channelReadFunctPtr(&rxFrame[rxFrameIndex], numOfBytes);
+    rxFrameIndex += numOfBytes;
+    
+    /* find the START_OF_FRAME, discarding anything before it */
+    while((sofIndex < rxFrameIndex) && (rxFrame[sofIndex] != START_OF_FRAME)){
+        sofIndex++;
+    }
+    
+    /* find the END_OF_FRAME; a START_OF_FRAME before it means that the
+     * end of the previous frame was lost, so start again from there */
+    eofIndex = sofIndex + 1;
+    while((eofIndex < rxFrameIndex) && (rxFrame[eofIndex] != END_OF_FRAME)){
+        if(rxFrame[eofIndex] == START_OF_FRAME)
+            sofIndex = eofIndex;
+        eofIndex++;
+    }
+    
+    if(eofIndex >= rxFrameIndex){
+        /* keep the partial frame at the beginning of the buffer; a frame
+         * that fills the buffer can never complete, so drop it */
+        for(i = 0; (i + sofIndex) < rxFrameIndex; i++){
+            rxFrame[i] = rxFrame[i + sofIndex];
         }
+        rxFrameIndex -= sofIndex;
         
-        length = i;
+        if(rxFrameIndex >= RX_FRAME_LENGTH)
+            rxFrameIndex = 0;
         
-        /* a full frame was just processed, find the next START_OF_FRAME and
-         * copy the remainder of the frame forward in preparation for
-         * the next frame reception */
-        i = eofIndex;
-        sofIndex = 0;
-        while(i < RX_FRAME_LENGTH){
-            if(rxFrame[i] == START_OF_FRAME){
-                sofIndex = i;
-                break;
-            }else{
-                rxFrame[i] = 0;
-            }
-            i++;
+        return 0;
+    }
+    
+    /* extract the received frame */
+    i = sofIndex + 1;
+    while(i < eofIndex){
+        if(length >= MAX_RECEIVE_MESSAGE_LEN){
+            length = 0;
+            break;
         }
-        rxFrameIndex = 0;
         
-        /* copy and clear */
-        if(sofIndex > 0){
-            i = 0;
-            while((i + sofIndex) < RX_FRAME_LENGTH){
-                rxFrame[i] = rxFrame[(i + sofIndex)];
-                rxFrame[(i + sofIndex)] = 0;
-                i++;
-            }
+        if((rxFrame[i] == ESC) && ((i + 1) < eofIndex)){
+            i++;
+            data[length] = rxFrame[i] ^ ESC_XOR;
+        }else{
+            data[length] = rxFrame[i];
         }
-        
-        /* check the data integrity using the last two bytes as
-         * the fletcher16 checksum */
-        checksum = data[length - 2] | (data[length - 1] << 8);
+        length++;
+        i++;
+    }
+    
+    /* copy the remainder forward in preparation for the next frame */
+    eofIndex++;
+    for(i = 0; (i + eofIndex) < rxFrameIndex; i++){
+        rxFrame[i] = rxFrame[i + eofIndex];
+    }
+    rxFrameIndex -= eofIndex;
+    
+    /* check the data integrity using the last two bytes as
+     * the fletcher16 checksum */
+    if(length > 2){
+        uint16_t checksum = data[length - 2] | (data[length - 1] << 8);
         length -= 2;
-        check = FRM_fletcher16(data, length);
-        if(check != checksum){
+        if(FRM_fletcher16(data, length) != checksum){
             length = 0;
         }
+    }else{
+        length = 0;
+    }
+    
+    if(length > 0){
+        stats.rxFrames++;
+        TRACE(TRACE_FRAME_RX, (length > 0xff) ? 0xff : length);
+    }else{
+        stats.rxErrors++;
+        TRACE(TRACE_FRAME_ERROR, 0);
+        TRACE_trigger(TRACE_REASON_FRAME_ERROR);
     }
     
     return length;
 }
+#endif
 
 uint16_t FRM_fletcher16(uint8_t* data, size_t length){
 	uint16_t sum1 = 0, sum2 = 0, checksum;
@@ -171,6 +484,11 @@ void FRM_assignChannelReadable(uint16_t (*functPtr)()){
 
 void FRM_assignChannelWriteable(uint16_t (*functPtr)()){
     channelWriteableFunctPtr = functPtr;
+    channelCapacity = functPtr();
+}
+
+void FRM_assignChannelSendable(uint16_t (*functPtr)()){
+    channelSendableFunctPtr = functPtr;
 }
 
 void FRM_assignChannelRead(void (*functPtr)(uint8_t* data, uint16_t length)){
@@ -179,4 +497,12 @@ void FRM_assignChannelRead(void (*functPtr)(uint8_t* data, uint16_t length)){
 
 void FRM_assignChannelWrite(void (*functPtr)(uint8_t* data, uint16_t length)){
     channelWriteFunctPtr = functPtr;
-}
\ No newline at end of file
+}
+
+void FRM_assignChannelHold(void (*functPtr)()){
+    channelHoldFunctPtr = functPtr;
+}
+
+void FRM_assignChannelRelease(void (*functPtr)(uint8_t data)){
+    channelReleaseFunctPtr = functPtr;
+}
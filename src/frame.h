@@ -5,10 +5,29 @@
 #include <stdbool.h>
 #include "dispatch_config.h"
 
+/** The frame counters, all running totals */
+typedef struct{
+    uint32_t txFrames;
+    uint32_t rxFrames;
+    uint16_t rxErrors;      /* frames failing the checksum or too long */
+    uint16_t txDropped;     /* frames dropped for want of channel credits */
+}FrameStats;
+
+/**
+ * Use to take the receive buffer from the arena, before any frames
+ * are pulled
+ */
+void FRM_initReceive(void);
+
 /**
- * Use to initialize a frame (usually at the start of a message)
+ * Use to initialize a frame (usually at the start of a message).  A frame
+ * that might not be sent in full on what the 'sendable' function allows
+ * is dropped whole: nothing is written until the next FRM_init().
+ * 
+ * @param length the most bytes that will be pushed to the frame
+ * @return 1 if the frame was started, 0 if it was dropped
  */
-void FRM_init(void);
+uint8_t FRM_init(uint16_t length);
 
 /**
  * Use to send data as part of a frame.  The frame must have been
@@ -25,6 +44,67 @@ void FRM_push(uint8_t data);
  */
 void FRM_finish(void);
 
+/**
+ * Returns the number of bytes that can be written to the channel
+ * without waiting; each byte pushed may take up to two
+ * 
+ * @return the number of bytes
+ */
+uint16_t FRM_writeable(void);
+
+/**
+ * Returns the number of bytes that can be pushed to the current frame
+ * without waiting on the channel, allowing for escapes or for the COBS
+ * code bytes.  With COBS, while the channel holds nothing but the open
+ * block, it is enough to fill the block and two more, which wait a byte
+ * time each for the block to go out.
+ * 
+ * @return the number of bytes
+ */
+uint16_t FRM_pushable(void);
+
+/**
+ * @return the most bytes that FRM_finish() may write to the channel; with
+ * COBS, no more than is left beside an open block that the channel holds
+ * alone, the rest waiting a byte time each for the block to go out
+ */
+uint16_t FRM_finishBytes(void);
+
+/**
+ * Returns a marker for the current position in the outgoing byte
+ * stream.  Taken just after FRM_finish(), the marker identifies the
+ * end of that frame.
+ * 
+ * @return the number of bytes written to the channel (wrapping)
+ */
+uint16_t FRM_txMarker(void);
+
+/**
+ * Use to determine if the frame ending at 'marker' has yet to be
+ * completely drained from the channel
+ * 
+ * @param marker a value previously returned by FRM_txMarker()
+ * @return true if any part of the frame is still waiting in the channel
+ */
+bool FRM_isQueued(uint16_t marker);
+
+/**
+ * Copies the frame counters
+ * 
+ * @param stats the destination for the counters
+ */
+void FRM_getStats(FrameStats* stats);
+
+/**
+ * Clears the frame counters
+ */
+void FRM_resetStats(void);
+
+/**
+ * @return the RAM taken by the frame module's variables, in bytes
+ */
+uint16_t FRM_staticBytes(void);
+
 /**
  * Use to read unframed data from the receive buffer
  * 
@@ -48,10 +128,21 @@ void FRM_assignChannelReadable(uint16_t (*functPtr)());
  * access library.
  *
  * @param functPtr a function pointer to a function which tells how
- * many bytes can be written to the channel output
+ * many bytes can be written to the channel output; the channel must be
+ * empty when assigned, as its capacity is taken from this function
  */
 void FRM_assignChannelWriteable(uint16_t (*functPtr)());
 
+/**
+ * Assigns the 'sendable' function from the hardware access library.
+ * Optional; without it, frames are never dropped.
+ *
+ * @param functPtr a function pointer to a function which tells how
+ * many bytes written to the channel output will be sent without waiting
+ * on flow control, 0xffff for no limit
+ */
+void FRM_assignChannelSendable(uint16_t (*functPtr)());
+
 /**
  * Assigns the 'read' function from the hardware access library.
  *
@@ -68,4 +159,23 @@ void FRM_assignChannelRead(void (*functPtr)(uint8_t* data, uint16_t length));
  */
 void FRM_assignChannelWrite(void (*functPtr)(uint8_t* data, uint16_t length));
 
+/**
+ * Assigns the 'hold' function from the hardware access library.
+ * Required with FRAMING_COBS, unused otherwise.
+ *
+ * @param functPtr a function pointer to a function which holds the next
+ * byte written to the channel output, and every byte after it, until the
+ * 'release' function is called
+ */
+void FRM_assignChannelHold(void (*functPtr)());
+
+/**
+ * Assigns the 'release' function from the hardware access library.
+ * Required with FRAMING_COBS, unused otherwise.
+ *
+ * @param functPtr a function pointer to a function which replaces the
+ * held byte with <data> and lets the held bytes be sent
+ */
+void FRM_assignChannelRelease(void (*functPtr)(uint8_t data));
+
 #endif
\ No newline at end of file
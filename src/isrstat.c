@@ -0,0 +1,62 @@
+#include "isrstat.h"
+#include "task.h"
+
+static volatile IsrStats isrStats[ISR_NUM_OF_IDS];
+static volatile uint16_t missedTicks = 0;
+
+void ISR_record(IsrId id, uint16_t entry, uint16_t latency){
+    volatile IsrStats* s = &isrStats[id];
+    uint16_t now = CCP3TMRL;
+    uint16_t duration;
+    
+    /* the timer wraps every tick, assume that no interrupt takes a tick */
+    if(now >= entry){
+        duration = now - entry;
+    }else{
+        duration = (now + TASK_CYCLES_PER_TICK) - entry;
+    }
+    
+    if(duration > s->maxDuration)
+        s->maxDuration = duration;
+    s->avgDuration = (uint16_t)((int32_t)s->avgDuration
+            + (((int32_t)duration - (int32_t)s->avgDuration) >> 3));
+    
+    if(latency != ISR_NO_LATENCY){
+        if(latency > s->maxLatency)
+            s->maxLatency = latency;
+        s->avgLatency = (uint16_t)((int32_t)s->avgLatency
+                + (((int32_t)latency - (int32_t)s->avgLatency) >> 3));
+    }
+}
+
+void ISR_countMissedTick(void){
+    missedTicks++;
+}
+
+void ISR_getStats(IsrId id, IsrStats* stats){
+    /* hold off the interrupts so that the copy is consistent */
+    __builtin_disi(0x3fff);
+    stats->maxLatency = isrStats[id].maxLatency;
+    stats->avgLatency = isrStats[id].avgLatency;
+    stats->maxDuration = isrStats[id].maxDuration;
+    stats->avgDuration = isrStats[id].avgDuration;
+    __builtin_disi(0x0000);
+}
+
+uint16_t ISR_getMissedTicks(void){
+    return missedTicks;
+}
+
+void ISR_resetStats(void){
+    uint16_t i;
+    
+    __builtin_disi(0x3fff);
+    for(i = 0; i < ISR_NUM_OF_IDS; i++){
+        isrStats[i].maxLatency = 0;
+        isrStats[i].avgLatency = 0;
+        isrStats[i].maxDuration = 0;
+        isrStats[i].avgDuration = 0;
+    }
+    missedTicks = 0;
+    __builtin_disi(0x0000);
+}
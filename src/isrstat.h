@@ -0,0 +1,103 @@
+#ifndef _ISRSTAT_H
+#define _ISRSTAT_H
+
+#include <stdint.h>
+#include <xc.h>
+
+/* the interrupts are only instrumented in debug builds */
+#ifdef __DEBUG
+#define ISR_STATS   1
+#else
+#define ISR_STATS   0
+#endif
+
+typedef enum isrid{
+    ISR_T1,
+    ISR_ADC1,
+    ISR_U1TX,
+    ISR_U1RX,
+    ISR_CCT3,
+    ISR_NUM_OF_IDS,
+    ISR_NONE = 0xff
+}IsrId;
+
+/* the interrupt that drives RB9 high for its duration, for a scope;
+ * ISR_NONE leaves RB9 alone */
+#define ISR_MARKER      ISR_T1
+
+/* the latency given to ISR_ENTER() by interrupts that have no
+ * way to measure it */
+#define ISR_NO_LATENCY  0xffff
+
+/** The statistics of an interrupt, all times in cycles */
+typedef struct{
+    uint16_t maxLatency;    /* from the interrupt event to entry */
+    uint16_t avgLatency;    /* moving average over about 8 entries */
+    uint16_t maxDuration;   /* from entry to exit, including any time
+                             * spent in higher priority interrupts */
+    uint16_t avgDuration;
+}IsrStats;
+
+#if ISR_STATS
+/**
+ * Place at the start of an interrupt, after any declarations
+ * 
+ * @param id the IsrId of the interrupt
+ * @param latency an expression giving the cycles since the interrupt
+ * event, such as the count of a timer that was reset by the event, or
+ * ISR_NO_LATENCY
+ */
+#define ISR_ENTER(id, latency)                                  \
+    uint16_t isrEntry = CCP3TMRL;                               \
+    uint16_t isrLatency = (latency);                            \
+    if((id) == ISR_MARKER) LATBbits.LATB9 = 1
+
+/**
+ * Place at every exit of an interrupt
+ * 
+ * @param id the IsrId of the interrupt
+ */
+#define ISR_EXIT(id)                                            \
+    do{                                                         \
+        ISR_record((id), isrEntry, isrLatency);                 \
+        if((id) == ISR_MARKER) LATBbits.LATB9 = 0;              \
+    }while(0)
+#else
+#define ISR_ENTER(id, latency)
+#define ISR_EXIT(id)
+#endif
+
+/**
+ * Records one execution of an interrupt, called by ISR_EXIT()
+ * 
+ * @param id the IsrId of the interrupt
+ * @param entry the CCP3 timer count on entry
+ * @param latency the latency on entry, or ISR_NO_LATENCY
+ */
+void ISR_record(IsrId id, uint16_t entry, uint16_t latency);
+
+/**
+ * Counts a timer 1 tick that arrived before the previous one was handled
+ */
+void ISR_countMissedTick(void);
+
+/**
+ * Copies the statistics of an interrupt
+ * 
+ * @param id the IsrId of the interrupt
+ * @param stats the destination for the statistics
+ */
+void ISR_getStats(IsrId id, IsrStats* stats);
+
+/**
+ * @return the number of timer 1 ticks that arrived before the
+ * previous one was handled
+ */
+uint16_t ISR_getMissedTicks(void);
+
+/**
+ * Clears the statistics of all of the interrupts
+ */
+void ISR_resetStats(void);
+
+#endif
@@ -1,17 +1,24 @@
 #include "libmathq15.h"
 
 /***************** local defines *****************/
+/* the tables are placed in program memory and read through the PSV
+ * window, so they take no data RAM whatever the constants model */
+#ifdef __XC16__
+#define TABLE_SPACE __attribute__((space(auto_psv)))
+#else
+#define TABLE_SPACE
+#endif
 
 /***************** variable declarations *****************/
 #if defined(SINE_TABLE_4BIT)
-    const q15_t sine_table[] = {  0, 3211, 6392, 9511, 12539, 15446, 18204, 20787,
+    const q15_t sine_table[] TABLE_SPACE = {  0, 3211, 6392, 9511, 12539, 15446, 18204, 20787,
                             23169, 25329, 27244, 28897, 30272, 31356, 32137, 32609};
     const int SINE_TABLE_ENTRIES = 16;
     const int SINE_TABLE_SHIFT = 10;
 
 #elif defined(SINE_TABLE_5BIT)
 
-    const q15_t sine_table[] = {0, 1607, 3211, 4807, 6392, 7961, 9511, 11038,
+    const q15_t sine_table[] TABLE_SPACE = {0, 1607, 3211, 4807, 6392, 7961, 9511, 11038,
                             12539, 14009, 15446, 16845, 18204, 19519, 20787, 22004,
                             23169, 24278, 25329, 26318, 27244, 28105, 28897, 29621,
                             30272, 30851, 31356, 31785, 32137, 32412, 32609, 32727};
@@ -20,7 +27,7 @@
 
 #elif defined(SINE_TABLE_6BIT)
 
-    const q15_t sine_table[] = {  0, 804, 1607, 2410, 3211, 4011, 4807, 5601,
+    const q15_t sine_table[] TABLE_SPACE = {  0, 804, 1607, 2410, 3211, 4011, 4807, 5601,
                             6392, 7179, 7961, 8739, 9511, 10278, 11038, 11792,
                             12539, 13278, 14009, 14732, 15446, 16150, 16845, 17530,
                             18204, 18867, 19519, 20159, 20787, 21402, 22004, 22594,
@@ -33,7 +40,7 @@
 
 #elif defined(SINE_TABLE_7BIT)
 
-    const q15_t sine_table[] = {0, 402, 804, 1206, 1607, 2009, 2410, 2811,
+    const q15_t sine_table[] TABLE_SPACE = {0, 402, 804, 1206, 1607, 2009, 2410, 2811,
                             3211, 3611, 4011, 4409, 4807, 5205, 5601, 5997,
                             6392, 6786, 7179, 7571, 7961, 8351, 8739, 9126,
                             9511, 9895, 10278, 10659, 11038, 11416, 11792, 12166,
@@ -54,7 +61,7 @@
 
 #else
 
-    const q15_t sine_table[] = {    0, 201, 402, 603, 804, 1005, 1206, 1406,
+    const q15_t sine_table[] TABLE_SPACE = {    0, 201, 402, 603, 804, 1005, 1206, 1406,
                             1607, 1808, 2009, 2209, 2410, 2610, 2811, 3011,
                             3211, 3411, 3611, 3811, 4011, 4210, 4409, 4608,
                             4807, 5006, 5205, 5403, 5601, 5799, 5997, 6195,
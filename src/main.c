@@ -12,6 +12,12 @@
 #include "dispatch.h"
 #include "dio.h"
 #include "uart.h"
+#include "isrstat.h"
+#include "priority.h"
+#include "trace.h"
+#include "mem.h"
+#include "arena.h"
+#include "clock.h"
 #include <string.h>
 
 /*********** Useful defines and macros ****************************************/
@@ -20,23 +26,177 @@
 #define GATE_VOLTAGE_AN     0x1010
 #define CURRENT_VOLTAGE_AN  0x1414
 
-#define NUM_OF_SAMPLES                 (128)
+/* NUM_OF_SAMPLES is set by the arena profile */
 #define HIGH_SPEED_THETA_INCREMENT     (65536/NUM_OF_SAMPLES)
 
-typedef enum vimode{OFFSET_CALIBRATION, TWO_TERMINAL, THREE_TERMINAL}ViMode;
+/* the waveform period at startup, in the host's 12 MHz cycles, and the
+ * longest timer 1 period; longer waveforms take more DAC steps instead */
+#define DEFAULT_HOST_PERIOD            1567
+#define MAX_TIMER_PERIOD               CLOCK_PERIOD_FROM_HOST(2000)
+
+/* the samples are stored right-justified with no loss: the load current is
+ * a single left-justified 12-bit conversion, while the load voltage is the
+ * difference of two and so takes 13 bits; this is not the q15 scale of the
+ * original "vi" topic, so the curve is sent as "vi2" */
+#define LOAD_VOLTAGE_SHIFT             3
+#define LOAD_CURRENT_SHIFT             3
+
+/* when set, "vi2" is sent delta-coded, otherwise as s16; the 12-bit packing
+ * can't be used since the load voltage needs 13 bits */
+#define VI_DELTA_CODED                 1
+
+#if VI_DELTA_CODED
+#define VI_FORMAT                      eD16
+#else
+#define VI_FORMAT                      eS16
+#endif
+
+/* "vi2" is sent as a resumable task, pushing no more than this many bytes
+ * each time that it executes, which bounds the time that it holds up the
+ * other tasks */
+#define VI_SLICE_BYTES                 48
+
+/* the "vi2" topic carries NUM_OF_SAMPLES of each array */
+#define STRINGIFY(x)                   #x
+#define TOPIC_DIM(x)                   STRINGIFY(x)
+#define VI_TOPIC_NAME                  "vi2"
+#define VI_TOPIC                       VI_TOPIC_NAME ":" TOPIC_DIM(NUM_OF_SAMPLES)
+
+/* the fields of the "status" topic, in topic string order */
+#define STATUS_TOPIC            "status,u16,s16,s16,s16,u8"
+#define STATUS_PERIOD           0x01
+#define STATUS_GATE_VOLTAGE     0x02
+#define STATUS_PEAK_VOLTAGE     0x04
+#define STATUS_OFFSET_VOLTAGE   0x08
+#define STATUS_MODE             0x10
+#define STATUS_ALL              0x1f
+
+/* the status is sent whenever it changes and every field is re-sent
+ * at the keepalive interval in order to refresh a host that connects late */
+#define STATUS_KEEPALIVE_MS         5000
+
+/* changes in the measured gate voltage smaller than this are noise */
+#define GATE_VOLTAGE_DEADBAND       64
+
+/* in debug builds, the statistics of one task are sent on "taskstats" every
+ * TASK_STATS_PERIOD_MS as a u32 array: the task slot, the task function
+ * address, then the fields of the TaskProfile in order */
+#define TASK_STATS_TOPIC            "taskstats:6"
+#define TASK_STATS_PERIOD_MS        100
+
+/* in debug builds, the interrupt statistics are sent on "isrstats" as a u16
+ * array: the IsrStats of each interrupt in IsrId order, then the number of
+ * missed timer 1 ticks */
+#define ISR_STATS_TOPIC             "isrstats:21"
+#define ISR_STATS_PERIOD_MS         1000
+
+/* the trace is sent on "trace" as a u16 array once it is frozen, either
+ * by a trigger or by the host sending the u16 event mask to "trace" */
+#define TRACE_TOPIC                 "trace:32"
+#define TRACE_CHECK_PERIOD_MS       100
+
+/* the RAM use is sent on "mem" as a u16 array of MemField, in bytes;
+ * the topic dimension must match MEM_NUM_OF_FIELDS */
+#define MEM_TOPIC                   "mem:8"
+#define MEM_PERIOD_MS               1000
+
+typedef enum memfield{
+    MEM_STATIC,         /* all static and global variables */
+    MEM_STACK_SIZE,
+    MEM_STACK_PEAK,
+    MEM_SAMPLES,        /* the captured sweep, the largest part of main.c */
+    MEM_UART,
+    MEM_DISPATCH,       /* including framing */
+    MEM_TASK,
+    MEM_TRACE,
+    MEM_NUM_OF_FIELDS
+}MemField;
+
+#if (TRACE_LENGTH * 2) != 32
+#error "TRACE_TOPIC must give two elements for each record"
+#endif
+
+/* the minimum time between "vi2" frames; a captured sweep is sent as soon
+ * as it completes once this much time has passed since the last one */
+#define VI_PERIOD_MS                500
+
+/* the events posted from the interrupts to the main loop */
+#define EVENT_SWEEP_CAPTURED        0
+
+/* the time for the gate voltage filter to settle after a new setpoint,
+ * after which the regulation is run once rather than waiting for its
+ * next period */
+#define GATE_SETTLING_MS            20
+
+/* flow control credits are exchanged on this topic in both directions, as
+ * a u16 count of bytes; the first grant from the host turns flow control
+ * on.  Each side sends a grant on credits it has held back for the purpose
+ * (TX_CREDIT_RESERVE on the device), so a grant never waits on the other
+ * side's, and the host must do the same */
+#define CREDIT_TOPIC                "credit"
+#define FLOW_CONTROL_PERIOD_MS      2
+
+/* the link health counters are published as a u32 array on "stats", the
+ * rates in units per STATS_PERIOD_MS (a little longer when held back by a
+ * sliced "vi2"), followed by the running totals */
+#define STATS_TOPIC                 "stats:13"
+#define STATS_PERIOD_MS             1000
+
+typedef enum statsfield{
+    STATS_RX_BYTES_RATE,
+    STATS_TX_BYTES_RATE,
+    STATS_RX_FRAMES_RATE,
+    STATS_TX_FRAMES_RATE,
+    STATS_RX_FRAME_ERRORS,
+    STATS_RX_OVERRUNS,
+    STATS_RX_FRAMING_ERRORS,
+    STATS_TX_STALLS,
+    STATS_TX_DROPPED,
+    STATS_SKIPPED_SWEEPS,
+    STATS_TX_THROTTLED_MS,
+    STATS_RX_THROTTLED_MS,
+    STATS_EVENT_OVERFLOWS,
+    STATS_NUM_OF_FIELDS
+}StatsField;
+
+/* each "vi2" frame that goes out is followed by the description of its sweep:
+ * the sweep sequence number, the time of the start of the sweep in us,
+ * and the mode, period and peak voltage that the sweep was taken with */
+#define SWEEP_TOPIC                 "sweep,u32,u32,u8,u16,s16"
+
+/* the values are the mode numbers sent to the host on "status", "sweep"
+ * and in the trace */
+typedef enum vimode{OFFSET_CALIBRATION = 0, TWO_TERMINAL = 2, THREE_TERMINAL = 3}ViMode;
+
+typedef struct{
+    uint32_t sequence;
+    uint32_t time;
+    uint8_t mode;
+    uint16_t period;
+    q15_t peakVoltage;
+}SweepInfo;
 
 /*********** Variable Declarations ********************************************/
 volatile q16angle_t theta = 0, omega = HIGH_SPEED_THETA_INCREMENT;
 volatile q15_t loadVoltageL = 0;
-volatile int16_t loadVoltage[NUM_OF_SAMPLES] = {0};
-volatile int16_t loadCurrent[NUM_OF_SAMPLES] = {0};
+volatile int16_t* loadVoltage;     /* NUM_OF_SAMPLES each, in the arena */
+volatile int16_t* loadCurrent;
 volatile q15_t gateVoltage = 0;
 volatile q15_t sampleIndex = 0;
 volatile q15_t dacSamplesPerAdcSamples = 1;
+volatile uint16_t hostPeriod = 0;
 volatile q15_t currentOffset = 0;
 
 volatile ViMode mode = TWO_TERMINAL;
-volatile uint8_t xmitActive = 0, xmitSent = 0;
+/* starting as sent, the first sweep captured is a whole one and has
+ * its snapshot taken */
+volatile uint8_t xmitActive = 0, xmitSent = 1;
+volatile uint16_t skippedSweeps = 0;
+
+/* every sweep is numbered, whether captured or not, so that the
+ * host can count the sweeps that it didn't receive */
+volatile uint32_t sweepSequence = 0;
+volatile SweepInfo capturedSweep;
 
 q15_t gateVoltageSetpoint = 0;
 q15_t voltageScaler = 32767;
@@ -55,11 +215,23 @@ void setDutyCyclePWM3(q15_t dutyCycle);
 q15_t getDutyCyclePWM2(void);
 
 void sendVI(void);
-void sendPeriod(void);
-void sendGateVoltage(void);
-void sendPeakVoltage(void);
-void sendOffsetVoltage(void);
-void sendMode(void);
+void sendSweep(void);
+void sweepCaptured(uint16_t payload);
+void sendCapturedSweep(uint16_t arg);
+uint8_t sendStatus(uint8_t keepalive);
+void regulateGateVoltage(void);
+void settleGateVoltage(uint16_t arg);
+void manageFlowControl(void);
+uint8_t sendStats(uint8_t keepalive);
+#if TASK_PROFILING
+uint8_t sendTaskStats(uint8_t keepalive);
+#endif
+#if ISR_STATS
+uint8_t sendIsrStats(uint8_t keepalive);
+#endif
+void sendTrace(void);
+uint8_t sendMem(uint8_t keepalive);
+uint16_t getPeriod(void);
 
 void changePeriod(void);
 void receiveOffsetCalibration(void);
@@ -67,9 +239,19 @@ void setGateVoltage(void);
 void setPeakVoltage(void);
 void setOffsetVoltage(void);
 void toggleMode(void);
+void receiveCredit(void);
+void resetStats(void);
+void requestTrace(void);
 
 /*********** Function Implementations *****************************************/
 int main(void) {
+    /* before anything else uses the stack */
+    MEM_paintStack();
+    
+    /* the samples must be in place before the interrupts are started */
+    loadVoltage = ARENA_region(ARENA_SAMPLES);
+    loadCurrent = loadVoltage + NUM_OF_SAMPLES;
+    
     /* setup the hardware */
     initOsc();
     initLowZAnalogOut();
@@ -82,8 +264,11 @@ int main(void) {
     UART_init();
     DIS_assignChannelReadable(&UART_readable);
     DIS_assignChannelWriteable(&UART_writeable);
+    DIS_assignChannelSendable(&UART_sendable);
     DIS_assignChannelRead(&UART_read);
     DIS_assignChannelWrite(&UART_write);
+    DIS_assignChannelHold(&UART_holdTx);
+    DIS_assignChannelRelease(&UART_releaseTx);
     DIS_init();
     
     /* initialize the task manager */
@@ -100,15 +285,50 @@ int main(void) {
     DIS_subscribe("peak voltage", &setPeakVoltage);
     DIS_subscribe("offset voltage", &setOffsetVoltage);
     DIS_subscribe("mode", &toggleMode);    
+    DIS_subscribe(CREDIT_TOPIC, &receiveCredit);
+    DIS_subscribe("stats reset", &resetStats);
+    DIS_subscribe("trace", &requestTrace);
+    
+    /* the periodic topics are sent by topic id once the host asks */
+    DIS_registerTopic(VI_TOPIC_NAME);
+    DIS_registerTopic("status");
+    DIS_registerTopic("sweep");
+    DIS_registerTopic(CREDIT_TOPIC);
+    DIS_registerTopic(STATS_TOPIC);
+    DIS_registerTopic(TRACE_TOPIC);
+    DIS_registerTopic(MEM_TOPIC);
+#if TASK_PROFILING
+    DIS_registerTopic(TASK_STATS_TOPIC);
+#endif
+#if ISR_STATS
+    DIS_registerTopic(ISR_STATS_TOPIC);
+#endif
+    
+    /* periodic topics only ever need their latest value to reach the host */
+    DIS_conflate(VI_TOPIC_NAME);
+    DIS_conflate("status");
+    
+    /* the status is only published when it changes, or to keep alive; the
+     * periodic topics are publishers too, so that one held back by a sliced
+     * "vi2" is retried as soon as it is out */
+    DIS_schedulePublisher(&sendStatus, STATUS_KEEPALIVE_MS);
+    DIS_schedulePublisher(&sendStats, STATS_PERIOD_MS);
+    DIS_schedulePublisher(&sendMem, MEM_PERIOD_MS);
+#if TASK_PROFILING
+    DIS_schedulePublisher(&sendTaskStats, TASK_STATS_PERIOD_MS);
+#endif
+#if ISR_STATS
+    DIS_schedulePublisher(&sendIsrStats, ISR_STATS_PERIOD_MS);
+#endif
     
     /* add necessary tasks */    
+    TASK_onEvent(EVENT_SWEEP_CAPTURED, &sweepCaptured);
+    
     TASK_add(&DIS_process, 1);
-    TASK_add(&sendVI, 500);
-    TASK_add(&sendPeriod, 499);
-    TASK_add(&sendGateVoltage, 498);
-    TASK_add(&sendPeakVoltage, 497);
-    TASK_add(&sendOffsetVoltage, 496);
-    TASK_add(&sendMode, 495);
+    TASK_add(&DIS_managePublishers, 1);
+    TASK_add(&regulateGateVoltage, 498);
+    TASK_add(&manageFlowControl, FLOW_CONTROL_PERIOD_MS);
+    TASK_add(&sendTrace, TRACE_CHECK_PERIOD_MS);
     
     TASK_manage();
     
@@ -117,8 +337,11 @@ int main(void) {
 /******************************************************************************/
 /* Tasks below this line */
 void sendVI(void){
+    static TaskState state = 0;
     uint16_t i;
     
+    TASK_BEGIN(state);
+    
     xmitActive = 1;
     
     if(mode == TWO_TERMINAL){
@@ -152,88 +375,356 @@ void sendVI(void){
         currentOffset = (q15_t)total;
         
         mode = TWO_TERMINAL;
+        TRACE(TRACE_MODE, mode);
+        DIS_notifyChanged(&sendStatus);
+    }
+    
+    /* the curve is sent a slice at a time so that the other tasks
+     * keep running while it goes out; the sweep is only described
+     * if its curve actually went out */
+    if(DIS_publishArraysBegin(VI_TOPIC, VI_FORMAT,
+            (int16_t*)loadVoltage, (int16_t*)loadCurrent)){
+        while(DIS_publishSlice(VI_SLICE_BYTES) == 0){
+            TASK_YIELD(state);
+        }
+        
+        sendSweep();
     }
     
-    DIS_publish_2s16("vi:128", (int16_t*)loadVoltage, (int16_t*)loadCurrent);
     xmitSent = 1;
     xmitActive = 0;
+    
+    TASK_remove(&sendVI);
+    
+    TASK_END(state);
 }
 
-void sendPeriod(void){
-    uint16_t period = PR1;
+void sweepCaptured(uint16_t payload){
+    static uint32_t lastSent = 0;
+    uint32_t now = TASK_getTime();
+    uint32_t elapsed = now - lastSent;
     
-    int i = 1;
-    while(i < dacSamplesPerAdcSamples){
-        period <<= 1;
-        i++;
+    /* the capture is held until it is sent, so a sweep that completes too
+     * soon after the last one is only delayed */
+    if(elapsed >= VI_PERIOD_MS){
+        if(TASK_add(&sendVI, 1)){
+            lastSent = now;
+            return;
+        }
+    }else{
+        if(TASK_after(&sendCapturedSweep, VI_PERIOD_MS - elapsed, 0)
+                != TASK_INVALID_HANDLE){
+            lastSent += VI_PERIOD_MS;
+            return;
+        }
     }
     
-    DIS_publish_u16("period", &period);
+    /* without a free task slot the capture is given up, so that the
+     * next sweep is captured in its place */
+    xmitSent = 1;
+}
+
+void sendCapturedSweep(uint16_t arg){
+    /* without a free task slot the capture is given up, so that the
+     * next sweep is captured in its place */
+    if(TASK_add(&sendVI, 1) == 0)
+        xmitSent = 1;
+}
+
+void sendSweep(void){
+    /* the captured sweep is not written while 'xmitActive' is set */
+    uint32_t sequence = capturedSweep.sequence;
+    uint32_t time = capturedSweep.time;
+    uint8_t sweepMode = capturedSweep.mode;
+    uint16_t period = capturedSweep.period;
+    q15_t peakVoltage = capturedSweep.peakVoltage;
+    
+    DIS_publish(SWEEP_TOPIC, &sequence, &time, &sweepMode, &period, &peakVoltage);
 }
 
-void sendGateVoltage(void){
-    DIS_publish_s16("gate voltage", (int16_t*)&gateVoltage);
+uint8_t sendStatus(uint8_t keepalive){
+    static uint16_t lastPeriod = 0;
+    static q15_t lastGateVoltage = 0, lastPeakVoltage = 0, lastOffsetVoltage = 0;
+    static uint8_t lastMode = 0;
     
-    /* when the gate voltage is sent, then add or subtract a small amount to the
-     * PWM based on the error */
+    uint16_t period = getPeriod();
+    q15_t gate = gateVoltage;
+    q15_t peak = voltageScaler;
+    q15_t offset = voltageOffset;
+    uint8_t modeNum = (uint8_t)mode;
+    uint8_t mask = 0, sent;
+    
+    void* fields[] = {&period, &gate, &peak, &offset, &modeNum};
+    
+    /* only send the fields that have changed since they were last sent */
+    if(keepalive){
+        mask = STATUS_ALL;
+    }else{
+        if(period != lastPeriod)
+            mask |= STATUS_PERIOD;
+        if(q15_abs(q15_add(gate, -lastGateVoltage)) > GATE_VOLTAGE_DEADBAND)
+            mask |= STATUS_GATE_VOLTAGE;
+        if(peak != lastPeakVoltage)
+            mask |= STATUS_PEAK_VOLTAGE;
+        if(offset != lastOffsetVoltage)
+            mask |= STATUS_OFFSET_VOLTAGE;
+        if(modeNum != lastMode)
+            mask |= STATUS_MODE;
+    }
+    
+    /* there is no mode to report during offset calibration */
+    if(modeNum == OFFSET_CALIBRATION)
+        mask &= ~STATUS_MODE;
+    
+    if(mask == 0)
+        return 1;
+    
+    sent = DIS_publish_fields(STATUS_TOPIC, mask, fields);
+    
+    /* only fields which actually went out are considered sent */
+    if(sent & STATUS_PERIOD)
+        lastPeriod = period;
+    if(sent & STATUS_GATE_VOLTAGE)
+        lastGateVoltage = gate;
+    if(sent & STATUS_PEAK_VOLTAGE)
+        lastPeakVoltage = peak;
+    if(sent & STATUS_OFFSET_VOLTAGE)
+        lastOffsetVoltage = offset;
+    if(sent & STATUS_MODE)
+        lastMode = modeNum;
+    
+    return (sent == mask);
+}
+
+void regulateGateVoltage(void){
+    /* add or subtract a small amount to the PWM based on the error */
     q15_t error = q15_add(gateVoltage, -gateVoltageSetpoint);
 
     q15_t dc = q15_add(getDutyCyclePWM2(), -error);
 
     setDutyCyclePWM2(dc);
+    
+    /* the status decides whether the gate voltage moved enough to report */
+    DIS_notifyChanged(&sendStatus);
+}
+
+void settleGateVoltage(uint16_t arg){
+    regulateGateVoltage();
+}
+
+void manageFlowControl(void){
+    uint16_t credits;
+    
+    UART_flowTick(FLOW_CONTROL_PERIOD_MS);
+    
+    /* the grant is only taken when it can go straight out, since a grant
+     * that never reaches the host is lost; a sliced publish that is under
+     * way would have to be finished first */
+    if(DIS_isPublishing())
+        return;
+    
+    /* grant the host the receive buffer space freed since the last grant */
+    /* the reserve means the grant is never dropped for credits, and nothing
+     * is sliced, so its frame always goes out */
+    credits = UART_takeRxCredits();
+    if(credits > 0){
+        UART_releaseTxReserve(1);
+        DIS_publish_u16(CREDIT_TOPIC, &credits);
+        UART_releaseTxReserve(0);
+    }
 }
 
-void sendPeakVoltage(void){
-    DIS_publish_s16("peak voltage", (int16_t*)&voltageScaler);
+uint8_t sendStats(uint8_t keepalive){
+    static uint32_t lastRxBytes = 0, lastTxBytes = 0;
+    static uint32_t lastRxFrames = 0, lastTxFrames = 0;
+    uint32_t stats[STATS_NUM_OF_FIELDS];
+    UartStats uartStats;
+    FrameStats frameStats;
+    
+    /* nothing else goes out during a sliced publish; the rates are kept
+     * for when it is done */
+    if(DIS_isPublishing())
+        return 0;
+    
+    UART_getStats(&uartStats);
+    DIS_getFrameStats(&frameStats);
+    
+    /* the rates are the change since the last time the stats were sent */
+    stats[STATS_RX_BYTES_RATE] = uartStats.rxBytes - lastRxBytes;
+    stats[STATS_TX_BYTES_RATE] = uartStats.txBytes - lastTxBytes;
+    stats[STATS_RX_FRAMES_RATE] = frameStats.rxFrames - lastRxFrames;
+    stats[STATS_TX_FRAMES_RATE] = frameStats.txFrames - lastTxFrames;
+    
+    stats[STATS_RX_FRAME_ERRORS] = frameStats.rxErrors;
+    stats[STATS_RX_OVERRUNS] = uartStats.rxOverruns;
+    stats[STATS_RX_FRAMING_ERRORS] = uartStats.rxFramingErrors;
+    stats[STATS_TX_STALLS] = uartStats.txStalls;
+    stats[STATS_TX_DROPPED] = frameStats.txDropped;
+    stats[STATS_SKIPPED_SWEEPS] = skippedSweeps;
+    stats[STATS_TX_THROTTLED_MS] = uartStats.txThrottledTime;
+    stats[STATS_RX_THROTTLED_MS] = uartStats.rxThrottledTime;
+    stats[STATS_EVENT_OVERFLOWS] = TASK_getEventOverflows();
+    
+    /* a dropped frame is retried, its rates then covering the longer time */
+    if(DIS_publish_u32(STATS_TOPIC, stats) == 0)
+        return 0;
+    
+    lastRxBytes = uartStats.rxBytes;
+    lastTxBytes = uartStats.txBytes;
+    lastRxFrames = frameStats.rxFrames;
+    lastTxFrames = frameStats.txFrames;
+    
+    return 1;
 }
 
-void sendOffsetVoltage(void){
-    DIS_publish_s16("offset voltage", (int16_t*)&voltageOffset);
+#if TASK_PROFILING
+uint8_t sendTaskStats(uint8_t keepalive){
+    static uint8_t slot = 0;
+    uint32_t stats[6];
+    TaskProfile profile;
+    uint8_t i, next = slot;
+    
+    if(DIS_isPublishing())
+        return 0;
+    
+    /* the tasks take turns, one per frame; a task whose frame was dropped
+     * keeps its turn */
+    for(i = 0; i < MAX_NUM_OF_TASKS; i++){
+        next++;
+        if(next >= MAX_NUM_OF_TASKS)
+            next = 0;
+        
+        if(TASK_getProfile(next, &profile)){
+            stats[0] = next;
+            stats[1] = (uint32_t)(uint16_t)profile.taskFunctPtr;
+            stats[2] = profile.maxCycles;
+            stats[3] = profile.avgCycles;
+            stats[4] = profile.maxLateness;
+            stats[5] = profile.overruns;
+            
+            if(DIS_publish_u32(TASK_STATS_TOPIC, stats) == 0)
+                return 0;
+            
+            slot = next;
+            break;
+        }
+    }
+    
+    return 1;
 }
+#endif
 
-void sendMode(void){
-    if(mode == TWO_TERMINAL)
-        DIS_publish_str("mode", "2");
-    else if(mode == THREE_TERMINAL)
-        DIS_publish_str("mode", "3");
+#if ISR_STATS
+uint8_t sendIsrStats(uint8_t keepalive){
+    uint16_t stats[(ISR_NUM_OF_IDS * 4) + 1];
+    IsrStats isr;
+    uint16_t i;
+    
+    if(DIS_isPublishing())
+        return 0;
+    
+    for(i = 0; i < ISR_NUM_OF_IDS; i++){
+        ISR_getStats((IsrId)i, &isr);
+        stats[(i * 4) + 0] = isr.maxLatency;
+        stats[(i * 4) + 1] = isr.avgLatency;
+        stats[(i * 4) + 2] = isr.maxDuration;
+        stats[(i * 4) + 3] = isr.avgDuration;
+    }
+    stats[ISR_NUM_OF_IDS * 4] = ISR_getMissedTicks();
+    
+    return DIS_publish_u16(ISR_STATS_TOPIC, stats);
+}
+#endif
+
+void sendTrace(void){
+    uint16_t records[TRACE_LENGTH * 2];
+    
+    /* the trace stays frozen until it has actually gone out */
+    if((TRACE_isFrozen() == 0) || DIS_isPublishing())
+        return;
+    
+    TRACE_read(records);
+    if(DIS_publish_u16(TRACE_TOPIC, records))
+        TRACE_resume();
+}
+
+uint8_t sendMem(uint8_t keepalive){
+    uint16_t mem[MEM_NUM_OF_FIELDS];
+    
+    if(DIS_isPublishing())
+        return 0;
+    
+    mem[MEM_STATIC] = MEM_getStaticBytes();
+    mem[MEM_STACK_SIZE] = MEM_getStackSize();
+    mem[MEM_STACK_PEAK] = MEM_getStackPeak();
+    mem[MEM_SAMPLES] = ARENA_regionBytes(ARENA_SAMPLES);
+    mem[MEM_UART] = UART_staticBytes();
+    mem[MEM_DISPATCH] = DIS_staticBytes();
+    mem[MEM_TASK] = TASK_staticBytes();
+    mem[MEM_TRACE] = TRACE_staticBytes();
+    
+    return DIS_publish_u16(MEM_TOPIC, mem);
 }
 
 /******************************************************************************/
 /* Subscribers below this line */
 void changePeriod(void){
-    uint16_t newPeriod;
+    uint32_t newPeriod = CLOCK_PERIOD_FROM_HOST((uint16_t)DIS_getScalar(0));
     q16angle_t newOmega = HIGH_SPEED_THETA_INCREMENT;
+    uint16_t shift = 0;
+    uint32_t newHostPeriod;
     dacSamplesPerAdcSamples = 1;
     
-    DIS_getElements(0, &newPeriod);
-    
-    while(newPeriod > 2000){
+    while(newPeriod > MAX_TIMER_PERIOD){
         newPeriod >>= 1;
         newOmega >>= 1;
         dacSamplesPerAdcSamples++;
+        shift++;
     }
     
+    /* the period actually in use, in the host's units; rounding may take
+     * it past what the host can send */
+    newHostPeriod = CLOCK_PERIOD_TO_HOST(newPeriod) << shift;
+    if(newHostPeriod > 0xffff)
+        newHostPeriod = 0xffff;
+    
+    /* the waveform interrupt must see the new period all at once */
+    __builtin_disi(0x3fff);
     omega = newOmega;
     theta = 0;
-    PR1 = newPeriod;
+    PR1 = (uint16_t)newPeriod;
+    hostPeriod = (uint16_t)newHostPeriod;
+    __builtin_disi(0x0000);
+    
+    DIS_notifyChanged(&sendStatus);
 }
 
 void receiveOffsetCalibration(void){
     mode = OFFSET_CALIBRATION;
+    TRACE(TRACE_MODE, mode);
 }
 
 void setGateVoltage(void){
-    DIS_getElements(0, &gateVoltageSetpoint);
+    static TaskHandle settling = TASK_INVALID_HANDLE;
+    
+    gateVoltageSetpoint = (q15_t)DIS_getScalar(0);
     
     setDutyCyclePWM2(gateVoltageSetpoint);
+    
+    /* a newer setpoint restarts the settling time; without a free task
+     * slot, the periodic regulation still brings the gate voltage in */
+    TASK_cancel(settling);
+    settling = TASK_after(&settleGateVoltage, GATE_SETTLING_MS, 0);
 }
 
 void setPeakVoltage(void){
-    DIS_getElements(0, &voltageScaler);
+    voltageScaler = (q15_t)DIS_getScalar(0);
+    DIS_notifyChanged(&sendStatus);
 }
 
 void setOffsetVoltage(void){
-    DIS_getElements(0, &voltageOffset);
+    voltageOffset = (q15_t)DIS_getScalar(0);
+    DIS_notifyChanged(&sendStatus);
 }
 
 void toggleMode(void){
@@ -242,6 +733,33 @@ void toggleMode(void){
     }else{
         mode = TWO_TERMINAL;
     }
+    TRACE(TRACE_MODE, mode);
+    
+    DIS_notifyChanged(&sendStatus);
+}
+
+void resetStats(void){
+    UART_resetStats();
+    DIS_resetFrameStats();
+    skippedSweeps = 0;
+#if TASK_PROFILING
+    TASK_resetProfiles();
+#endif
+#if ISR_STATS
+    ISR_resetStats();
+#endif
+}
+
+void requestTrace(void){
+    /* the trace so far is sent with the old mask, the new mask applies
+     * once recording resumes */
+    TRACE_trigger(TRACE_REASON_REQUEST);
+    TRACE_setMask((uint16_t)DIS_getScalar(0));
+}
+
+void receiveCredit(void){
+    /* the host sends credits once it wants flow control */
+    UART_addTxCredits((uint16_t)DIS_getScalar(0));
 }
 
 /******************************************************************************/
@@ -294,6 +812,12 @@ q15_t getDutyCyclePWM2(void){
     return q15_div((q15_t)CCP2RB, (q15_t)CCP2PRL);
 }
 
+uint16_t getPeriod(void){
+    /* worked out when the period changes, since the conversion from
+     * cycles is too slow for the waveform interrupt */
+    return hostPeriod;
+}
+
 /******************************************************************************/
 /* Initialization functions below this line */
 void initOsc(void){
@@ -301,6 +825,11 @@ void initOsc(void){
      * on the highest internal frequency;  this will likely
      * change soon */
     CLKDIV = 0;
+    
+#if CLOCK_PROFILE == CLOCK_PROFILE_FRCPLL
+    /* the PLL relocks after its input changes */
+    while(OSCCONbits.LOCK == 0);
+#endif
 
     return;
 }
@@ -330,18 +859,20 @@ void initLowZAnalogOut(void){
 
 void initInterrupts(void){
     /* configure the global interrupt conditions */
-    /* interrupt nesting disabled, DISI instruction active */
-    INTCON1 = 0x8000;
+    /* interrupt nesting enabled, DISI instruction active */
+    INTCON1 = 0x0000;
     INTCON2 = 0x4000;
     
     /* initialize the period */
     dacSamplesPerAdcSamples = 1;
     omega = HIGH_SPEED_THETA_INCREMENT;
     theta = 0;
-    PR1 = 1567;
+    PR1 = (uint16_t)CLOCK_PERIOD_FROM_HOST(DEFAULT_HOST_PERIOD);
+    hostPeriod = DEFAULT_HOST_PERIOD;
     
     /* timer interrupts */
     T1CON = 0x0000;
+    IPC0bits.T1IP = PRIORITY_T1;
     IFS0bits.T1IF = 0;
     IEC0bits.T1IE = 1;
     T1CONbits.TON = 1;
@@ -402,7 +933,7 @@ void initAdc(void){
     AD1CON1 = 0x0200;   /* Clear sample bit to trigger conversion
                          * FORM = left justified  */
     AD1CON2 = 0x0000;   /* Set AD1IF after every 1 samples */
-    AD1CON3 = 0x0007;   /* Sample time = 1Tad, Tad = 8 * Tcy */
+    AD1CON3 = CLOCK_ADCS;   /* Sample time = 1Tad, Tad = (ADCS + 1) * Tcy */
     
     AD1CHS = CURRENT_VOLTAGE_AN;    /* AN1 */
     AD1CSSL = 0;
@@ -411,6 +942,7 @@ void initAdc(void){
     AD1CON1bits.ASAM = 1; // auto-sample
     
     /* analog-to-digital interrupts */
+    IPC3bits.AD1IP = PRIORITY_ADC1;
     IFS0bits.AD1IF = 0;
     IEC0bits.AD1IE = 1;
     
@@ -424,6 +956,15 @@ void initAdc(void){
  */
 void _ISR _T1Interrupt(void){
     static int countUp = 0;
+    
+    /* timer 1 restarts from 0 on the period match */
+    ISR_ENTER(ISR_T1, TMR1);
+    TRACE(TRACE_ISR_T1, 0);
+    
+    /* clearing the flag first means that a tick arriving while this one
+     * is handled is kept, to be handled late, rather than lost */
+    IFS0bits.T1IF = 0;
+    
     theta += omega;
     
     if(mode == THREE_TERMINAL){
@@ -459,9 +1000,25 @@ void _ISR _T1Interrupt(void){
     
     /* reset sampleIndex on every cycle */
     if(theta == 0){
-        if((xmitActive == 0) && (xmitSent == 1) && (countUp)){
-            sampleIndex = 0;
-            xmitSent = 0;
+        if(countUp){
+            sweepSequence++;
+            
+            if((xmitActive == 0) && (xmitSent == 1)){
+                sampleIndex = 0;
+                xmitSent = 0;
+                
+                /* T1 runs at the highest priority in use and the
+                 * settings are only written by tasks, below every
+                 * interrupt, so they can't change part way through */
+                capturedSweep.sequence = sweepSequence;
+                capturedSweep.time = TASK_getMicros();
+                capturedSweep.mode = (uint8_t)mode;
+                capturedSweep.period = getPeriod();
+                capturedSweep.peakVoltage = voltageScaler;
+            }else{
+                /* the last sweep hasn't been sent, so this one is lost */
+                skippedSweeps++;
+            }
         }
         
         AD1CON1bits.SAMP = 0;
@@ -470,12 +1027,20 @@ void _ISR _T1Interrupt(void){
         AD1CON1bits.SAMP = 0;
     }
     
-    IFS0bits.T1IF = 0;
+#if ISR_STATS
+    if(IFS0bits.T1IF)
+        ISR_countMissedTick();
+#endif
+    
+    ISR_EXIT(ISR_T1);
     
     return;
 }
 
 void _ISR _ADC1Interrupt(void){
+    ISR_ENTER(ISR_ADC1, ISR_NO_LATENCY);
+    TRACE(TRACE_ISR_ADC1, 0);
+    
     switch(AD1CHS){
         case LD_VOLTAGE_1_AN:
         {
@@ -494,7 +1059,7 @@ void _ISR _ADC1Interrupt(void){
             setDutyCyclePWM3(dc);
             
             if((sampleIndex < NUM_OF_SAMPLES) && (xmitActive == 0)){
-                loadVoltage[sampleIndex] = sample;
+                loadVoltage[sampleIndex] = sample >> LOAD_VOLTAGE_SHIFT;
             }
             
             AD1CHS = CURRENT_VOLTAGE_AN;
@@ -511,11 +1076,19 @@ void _ISR _ADC1Interrupt(void){
             setDutyCyclePWM4(dc);
             
             if((sampleIndex < NUM_OF_SAMPLES) && (xmitActive == 0)){
-                loadCurrent[sampleIndex] = sample;
+                loadCurrent[sampleIndex] = sample >> LOAD_CURRENT_SHIFT;
             }
 
             sampleIndex++;
             if(sampleIndex >= NUM_OF_SAMPLES){
+                /* hand the completed capture to the main loop */
+                if((sampleIndex == NUM_OF_SAMPLES) && (xmitActive == 0) && (xmitSent == 0)){
+                    /* a capture that can't be handed over is given up,
+                     * or no sweep would ever be captured again */
+                    if(TASK_post(EVENT_SWEEP_CAPTURED, 0) == 0)
+                        xmitSent = 1;
+                }
+                
                 sampleIndex = NUM_OF_SAMPLES;
             }
 
@@ -538,5 +1111,7 @@ void _ISR _ADC1Interrupt(void){
     
     /* clear the flag */
     IFS0bits.AD1IF = 0;
+    
+    ISR_EXIT(ISR_ADC1);
 }
 
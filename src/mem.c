@@ -0,0 +1,40 @@
+#include <xc.h>
+#include "mem.h"
+
+/* the stack bounds, placed by the linker after the static variables and
+ * loaded into W15 and SPLIM by the C startup code */
+extern uint16_t _SP_init;
+extern uint16_t _SPLIM_init;
+
+/* the words just above the stack pointer belong to this function */
+#define PAINT_MARGIN    8
+
+void MEM_paintStack(void){
+    uint16_t* p = (uint16_t*)(WREG15 + PAINT_MARGIN);
+    uint16_t* limit = &_SPLIM_init;
+    
+    /* the stack grows upward, toward SPLIM */
+    while(p <= limit){
+        *p++ = MEM_STACK_PAINT;
+    }
+}
+
+uint16_t MEM_getStackPeak(void){
+    uint16_t* p = &_SPLIM_init;
+    uint16_t* base = &_SP_init;
+    
+    while((p > base) && (*p == MEM_STACK_PAINT)){
+        p--;
+    }
+    
+    return (uint16_t)((uint8_t*)p - (uint8_t*)base) + 2;
+}
+
+uint16_t MEM_getStackSize(void){
+    /* the stack limit is the last usable word */
+    return (uint16_t)((uint8_t*)&_SPLIM_init - (uint8_t*)&_SP_init) + 2;
+}
+
+uint16_t MEM_getStaticBytes(void){
+    return (uint16_t)&_SP_init - MEM_DATA_BASE;
+}
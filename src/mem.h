@@ -0,0 +1,38 @@
+#ifndef _MEM_H
+#define _MEM_H
+
+#include <stdint.h>
+
+/* the start of RAM, from the linker script */
+#define MEM_DATA_BASE   0x0800
+
+/* the value written to the unused stack at startup */
+#define MEM_STACK_PAINT 0x5a5a
+
+/**
+ * Fills the unused part of the stack with MEM_STACK_PAINT; call first
+ * thing in main()
+ */
+void MEM_paintStack(void);
+
+/**
+ * Finds the most stack used since startup by searching down from the
+ * stack limit for the first word that is no longer painted; takes a
+ * little time when the stack is mostly unused, so call from a slow task
+ * 
+ * @return the peak stack usage in bytes
+ */
+uint16_t MEM_getStackPeak(void);
+
+/**
+ * @return the size of the stack in bytes
+ */
+uint16_t MEM_getStackSize(void);
+
+/**
+ * @return the RAM below the stack, taken by static and global
+ * variables, in bytes
+ */
+uint16_t MEM_getStaticBytes(void);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef _PRIORITY_H
+#define _PRIORITY_H
+
+/* The interrupt priorities, 1 (lowest) to 6; the main loop runs at 0.
+ * Interrupts are nested, so a higher priority interrupt preempts a lower
+ * priority one; interrupts at the same priority never preempt each other.
+ * 
+ *  - the waveform (T1) and sampling (ADC) interrupts share the highest
+ *    priority so that nothing else delays the DAC update, and so that
+ *    they may share 'sampleIndex' without protection
+ *  - the UART interrupts only share their buffers with the main loop
+ *  - the tick (CCT3) interrupt is the lowest, and increments the tick
+ *    count under DISI so that higher priority readers never see it torn */
+#define PRIORITY_T1     6
+#define PRIORITY_ADC1   6
+#define PRIORITY_U1RX   4
+#define PRIORITY_U1TX   4
+#define PRIORITY_CCT3   2
+
+/* the DISI instruction holds off priorities 1 to 6 only, the code that
+ * claims shared state with it relies on no interrupt being above 6 */
+#if (PRIORITY_T1 < 1) || (PRIORITY_T1 > 6) || \
+    (PRIORITY_ADC1 < 1) || (PRIORITY_ADC1 > 6) || \
+    (PRIORITY_U1RX < 1) || (PRIORITY_U1RX > 6) || \
+    (PRIORITY_U1TX < 1) || (PRIORITY_U1TX > 6) || \
+    (PRIORITY_CCT3 < 1) || (PRIORITY_CCT3 > 6)
+#error "interrupt priorities must be between 1 and 6"
+#endif
+
+#if PRIORITY_T1 != PRIORITY_ADC1
+#error "the T1 and ADC interrupts share 'sampleIndex' and must have the same priority"
+#endif
+
+#endif
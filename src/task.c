@@ -7,79 +7,121 @@
 
 #include <xc.h>
 #include "task.h"
+#include "isrstat.h"
+#include "priority.h"
+#include "trace.h"
 
-#define MAX_NUM_OF_TASKS	10
-#define MAX_SYS_TICKS_VAL	0x7ff00000
+#define TASK_CYCLES_PER_MICRO	(TASK_CYCLES_PER_TICK / 1000)
 
-/* create structure that consists of a function pointer and period */
+/* wrap-safe: true when time 'a' is at or after time 'b', provided that the
+ * two are within 2^31 ticks of one another */
+#define TIME_REACHED(a, b)	((int32_t)((a) - (b)) >= 0)
+
+/* create structure that consists of a function pointer and period; one-shot
+ * timers use 'timerFunctPtr' and 'arg' instead */
 typedef struct {
 	void (*taskFunctPtr)();
+	void (*timerFunctPtr)(uint16_t arg);
 	uint32_t period;
 	uint32_t nextExecutionTime;
+	uint16_t arg;
+	uint8_t heapIndex;
+	uint8_t generation;
+#if TASK_PROFILING
+	/* 16 bits each to keep the slots small, saturating at 0xffff */
+	uint16_t maxCycles;
+	uint16_t avgCycles;
+	uint16_t maxLateness;
+	uint16_t overruns;
+#endif
 }Task;
 
+/* the tasks stay in their slots while 'heap' holds the slot numbers of
+ * the active tasks as a binary min-heap ordered by next execution time,
+ * so that the next task due is always heap[0] */
 static Task task[MAX_NUM_OF_TASKS];
+static uint8_t heap[MAX_NUM_OF_TASKS];
+static uint8_t heapLength = 0;
 static volatile uint32_t systemTicks = 0;
 
+/* the event queue has a single consumer, the main loop, which alone moves
+ * 'eventHead'; the producers only move 'eventTail' */
+static void (*eventFunctPtr[MAX_NUM_OF_EVENT_TYPES])(uint16_t payload);
+static volatile uint8_t eventId[MAX_NUM_OF_EVENTS];
+static volatile uint16_t eventPayload[MAX_NUM_OF_EVENTS];
+static volatile uint8_t eventHead = 0, eventTail = 0;
+static volatile uint16_t eventOverflows = 0;
+
 void (*TMR_timedFunctPtr)();
 
 void TASK_systemTicksCounter();	// function declaration
 void TMR_init(void (*functPtr)());
 void TMR_disableInterrupt();
 
+static void TASK_heapSwap(uint8_t i, uint8_t j);
+static void TASK_siftUp(uint8_t i);
+static void TASK_siftDown(uint8_t i);
+static void TASK_heapRemove(uint8_t i);
+static int16_t TASK_allocate(uint32_t period, uint32_t ticks);
+static void TASK_free(uint8_t i);
+static uint8_t TASK_dispatchEvent(void);
+static void TASK_readTimebase(uint32_t* ticks, uint16_t* cycles);
+#if TASK_PROFILING
+static uint32_t TASK_getCycles(void);
+static void TASK_clearProfile(uint8_t i);
+static void TASK_profile(uint8_t i, uint32_t scheduled, uint32_t start, uint32_t end);
+static uint16_t TASK_saturate(uint32_t value);
+#endif
+
 void TASK_systemTicksCounter(){
+	/* the count is left to wrap, the times are always compared
+	 * as signed differences */
 	systemTicks++;
-
-	/* gracefully reset the system ticks counter
-	 * if it is about to roll over */
-	if(systemTicks >= MAX_SYS_TICKS_VAL){
-		TASK_resetTime(0);
-	}
 }
 
 uint32_t TASK_getTime(){
-    uint8_t sameFlag = 0;
-    uint32_t now0 = systemTicks;
-    uint32_t now1 = systemTicks;
+    uint32_t now;
     
-    /* this code ensures that two sequential reads get the same value
-     * before returning in order to avoid problems with atomic reads
-     * of the systemTicks location (a 32-bit value on a 16-bit processor) */
-    while(sameFlag == 0){
-        now0 = systemTicks;
-        now1 = systemTicks;
-        
-        if(now0 == now1){
-            sameFlag = 1;
-        }
-    }
+    /* the systemTicks location is a 32-bit value on a 16-bit processor, so
+     * read it until the same value is seen twice in a row to be sure that
+     * both halves belong together */
+    do{
+        now = systemTicks;
+    }while(now != systemTicks);
     
-	return now0;
+	return now;
 }
 
-void TASK_resetTime(uint32_t time){
-    uint32_t now = TASK_getTime();
-	if(time != now){
-		uint8_t i = 0;
-
-		/* determine the amount of time before each task needs to execute again */
-		int32_t timeUntilNextExecution[MAX_NUM_OF_TASKS];
-		for(i = 0; i < MAX_NUM_OF_TASKS; i++){
-			timeUntilNextExecution[i] = (int32_t)task[i].nextExecutionTime - now;
-			if(timeUntilNextExecution[i] < 0)
-				timeUntilNextExecution[i] = 0;
-		}
-
-        /* reset the clock */
-		TMR_disableInterrupt();
-		systemTicks = time;
-        TMR_init(&TASK_systemTicksCounter);
+uint32_t TASK_getMicros(){
+	uint32_t ticks;
+	uint16_t cycles;
+	
+	TASK_readTimebase(&ticks, &cycles);
+	
+	return (ticks * 1000) + (cycles / TASK_CYCLES_PER_MICRO);
+}
 
-		/* place the difference between the time that each task needed to execute and the new time */
-		for(i = 0; i < MAX_NUM_OF_TASKS; i++){
-			task[i].nextExecutionTime = (uint32_t)timeUntilNextExecution[i] + time;
-		}
-	}
+void TASK_readTimebase(uint32_t* ticks, uint16_t* cycles){
+	uint32_t t;
+	uint16_t c;
+	uint8_t pending;
+	
+	/* read the tick count either side of the timer so that
+	 * the two are known to belong together */
+	do{
+		t = systemTicks;
+		c = CCP3TMRL;
+		pending = IFS1bits.CCT3IF;
+	}while(t != systemTicks);
+	
+	/* when read from an interrupt that holds off the tick interrupt, the timer
+	 * may have wrapped without the tick being counted yet; a low count with
+	 * the flag set means that the wrap came before the timer was read */
+	if(pending && (c < (TASK_CYCLES_PER_TICK / 2)))
+		t++;
+	
+	*ticks = t;
+	*cycles = c;
 }
 
 void TASK_init(){
@@ -89,14 +131,25 @@ void TASK_init(){
     uint16_t i;
     for(i = 0; i < MAX_NUM_OF_TASKS; i++){
     	task[i].taskFunctPtr = 0;
+    	task[i].timerFunctPtr = 0;
     	task[i].period = 1;
     	task[i].nextExecutionTime = 1;
+    	task[i].generation = 0;
+#if TASK_PROFILING
+    	TASK_clearProfile(i);
+#endif
+    }
+    
+    heapLength = 0;
+    
+    for(i = 0; i < MAX_NUM_OF_EVENT_TYPES; i++){
+    	eventFunctPtr[i] = 0;
     }
+    eventHead = eventTail = 0;
 }
 
-void TASK_add(void (*functPtr)(), uint32_t period){
+uint8_t TASK_add(void (*functPtr)(), uint32_t period){
 	uint16_t i;
-	uint8_t taskExists = 0;
 
 	/* ensure that the task does not currently already exist with the same period */
 	for(i = 0; i < MAX_NUM_OF_TASKS; i++){
@@ -104,25 +157,143 @@ void TASK_add(void (*functPtr)(), uint32_t period){
 			if(task[i].period != period){
 				task[i].period = period;
 				task[i].nextExecutionTime = systemTicks + period;
+				
+				/* the task may now be due sooner or later */
+				TASK_siftUp(task[i].heapIndex);
+				TASK_siftDown(task[i].heapIndex);
 			}
 
-			taskExists = 1;
+			return 1;
 		}
 	}
 
 	/* save the task */
-	if(taskExists == 0){
-		for(i = 0; i < MAX_NUM_OF_TASKS; i++){
-			/* look for an empty task */
-			if(task[i].taskFunctPtr == 0){
-				task[i].taskFunctPtr = functPtr;
-				task[i].period = period;
-				task[i].nextExecutionTime = systemTicks + period;
+	int16_t slot = TASK_allocate(period, period);
+	if(slot < 0)
+		return 0;
+	
+	task[slot].taskFunctPtr = functPtr;
+#if TASK_PROFILING
+	TASK_clearProfile(slot);
+#endif
+	
+	return 1;
+}
 
-				break;
-			}
+TaskHandle TASK_after(void (*functPtr)(uint16_t arg), uint32_t ticks, uint16_t arg){
+	int16_t slot = TASK_allocate(0, ticks);
+	
+	if(slot < 0)
+		return TASK_INVALID_HANDLE;
+	
+	task[slot].timerFunctPtr = functPtr;
+	task[slot].arg = arg;
+	
+	return ((TaskHandle)task[slot].generation << 8) | (TaskHandle)slot;
+}
+
+uint8_t TASK_cancel(TaskHandle handle){
+	uint8_t i = (uint8_t)(handle & 0x00ff);
+	
+	if((i < MAX_NUM_OF_TASKS)
+			&& (task[i].timerFunctPtr != 0)
+			&& (task[i].generation == (uint8_t)(handle >> 8))){
+		TASK_free(i);
+		return 1;
+	}
+	
+	return 0;
+}
+
+void TASK_onEvent(uint8_t event, void (*functPtr)(uint16_t payload)){
+	if(event < MAX_NUM_OF_EVENT_TYPES)
+		eventFunctPtr[event] = functPtr;
+}
+
+uint8_t TASK_post(uint8_t event, uint16_t payload){
+	uint8_t posted = 0;
+	
+	/* claim and fill the slot with the interrupts held off so that posts
+	 * from interrupts of different priorities can't interleave */
+	__builtin_disi(0x3fff);
+	if((uint8_t)(eventTail - eventHead) < MAX_NUM_OF_EVENTS){
+		uint8_t i = eventTail & (MAX_NUM_OF_EVENTS - 1);
+		
+		eventId[i] = event;
+		eventPayload[i] = payload;
+		eventTail++;
+		posted = 1;
+	}else{
+		eventOverflows++;
+	}
+	__builtin_disi(0x0000);
+	
+	return posted;
+}
+
+uint16_t TASK_getEventOverflows(){
+	return eventOverflows;
+}
+
+uint16_t TASK_staticBytes(){
+	return sizeof(task) + sizeof(heap)
+			+ sizeof(eventFunctPtr) + sizeof(eventId) + sizeof(eventPayload);
+}
+
+uint8_t TASK_dispatchEvent(void){
+	uint8_t i, event;
+	uint16_t payload;
+	
+	if(eventHead == eventTail)
+		return 0;
+	
+	/* the slot is released before the handler executes so
+	 * that the handler may post another event */
+	i = eventHead & (MAX_NUM_OF_EVENTS - 1);
+	event = eventId[i];
+	payload = eventPayload[i];
+	eventHead++;
+	
+	if((event < MAX_NUM_OF_EVENT_TYPES) && (eventFunctPtr[event] != 0))
+		eventFunctPtr[event](payload);
+	
+	return 1;
+}
+
+int16_t TASK_allocate(uint32_t period, uint32_t ticks){
+	uint16_t i;
+	
+	for(i = 0; i < MAX_NUM_OF_TASKS; i++){
+		/* look for an empty task */
+		if((task[i].taskFunctPtr == 0) && (task[i].timerFunctPtr == 0)){
+			task[i].period = period;
+			task[i].nextExecutionTime = systemTicks + ticks;
+			
+			/* a new generation invalidates any handles to the last
+			 * timer in this slot; generation 0 is never used so that
+			 * no handle is ever TASK_INVALID_HANDLE */
+			task[i].generation++;
+			if(task[i].generation == 0)
+				task[i].generation = 1;
+
+			task[i].heapIndex = heapLength;
+			heap[heapLength] = i;
+			heapLength++;
+			TASK_siftUp(task[i].heapIndex);
+
+			return (int16_t)i;
 		}
 	}
+	
+	return -1;
+}
+
+void TASK_free(uint8_t i){
+	TASK_heapRemove(task[i].heapIndex);
+	
+	task[i].taskFunctPtr = 0;
+	task[i].timerFunctPtr = 0;
+	task[i].period = 10000;
 }
 
 void TASK_remove(void (*functPtr)()){
@@ -130,36 +301,210 @@ void TASK_remove(void (*functPtr)()){
 
 	for(i = 0; i < MAX_NUM_OF_TASKS; i++){
 		if(task[i].taskFunctPtr == functPtr){
-			task[i].taskFunctPtr = 0;
-			task[i].period = 10000;
-			task[i].nextExecutionTime = MAX_SYS_TICKS_VAL;
+			TASK_free(i);
 		}
 	}
 }
 
 void TASK_manage(){
+	uint16_t ipl;
+	
 	while(1){
-		uint16_t i;
-		for(i = 0; i < MAX_NUM_OF_TASKS; i++){
+		/* the events are handled ahead of the tasks */
+		if(TASK_dispatchEvent()){
+			ClrWdt();
+			continue;
+		}
+		
+		/* only the task at the top of the heap can be due */
+		if(heapLength > 0){
+			uint8_t next = heap[0];
 			uint32_t time = TASK_getTime();
-			if(task[i].taskFunctPtr != 0){
-				if(time >= task[i].nextExecutionTime){
-					task[i].nextExecutionTime = task[i].period + time;
-					(task[i].taskFunctPtr)();
+			
+			if(TIME_REACHED(time, task[next].nextExecutionTime)){
+				TRACE(TRACE_TASK, next);
+				
+				if(task[next].timerFunctPtr != 0){
+					/* a one-shot timer frees its slot before executing
+					 * so that it may start another timer */
+					void (*timerFunctPtr)(uint16_t arg) = task[next].timerFunctPtr;
+					uint16_t arg = task[next].arg;
+					
+					TASK_free(next);
+					timerFunctPtr(arg);
+				}else{
+					/* reschedule before executing so that the task
+					 * may add or remove tasks, including itself */
+#if TASK_PROFILING
+					uint32_t scheduled = task[next].nextExecutionTime;
+					uint32_t start = TASK_getCycles();
+#endif
+					task[next].nextExecutionTime = task[next].period + time;
+					TASK_siftDown(0);
+					
+					(task[next].taskFunctPtr)();
+#if TASK_PROFILING
+					TASK_profile(next, scheduled, start, TASK_getCycles());
+#endif
 				}
+				
+				ClrWdt();
+				continue;
 			}
 		}
-        
-        ClrWdt();
+		
+		ClrWdt();
+		
+		/* nothing is due before the next tick, so wait for an interrupt; the
+		 * check is made again with the CPU priority raised so that an event
+		 * posted or a tick counted since can't be missed.  Any enabled
+		 * interrupt still wakes the CPU from Idle, the tick at the latest,
+		 * even at or below the CPU priority, and is taken once it is restored */
+		SET_AND_SAVE_CPU_IPL(ipl, 7);
+		if((eventHead == eventTail) && ((heapLength == 0)
+				|| !TIME_REACHED(TASK_getTime(), task[heap[0]].nextExecutionTime))){
+			Idle();
+		}
+		RESTORE_CPU_IPL(ipl);
+	}
+}
+
+#if TASK_PROFILING
+uint8_t TASK_getProfile(uint8_t slot, TaskProfile* profile){
+	if((slot >= MAX_NUM_OF_TASKS) || (task[slot].taskFunctPtr == 0))
+		return 0;
+	
+	profile->taskFunctPtr = task[slot].taskFunctPtr;
+	profile->maxCycles = task[slot].maxCycles;
+	profile->avgCycles = task[slot].avgCycles;
+	profile->maxLateness = task[slot].maxLateness;
+	profile->overruns = task[slot].overruns;
+	
+	return 1;
+}
+
+void TASK_resetProfiles(){
+	uint16_t i;
+	
+	for(i = 0; i < MAX_NUM_OF_TASKS; i++){
+		TASK_clearProfile(i);
+	}
+}
+
+uint32_t TASK_getCycles(void){
+	uint32_t ticks;
+	uint16_t cycles;
+	
+	TASK_readTimebase(&ticks, &cycles);
+	
+	return (ticks * TASK_CYCLES_PER_TICK) + cycles;
+}
+
+void TASK_clearProfile(uint8_t i){
+	task[i].maxCycles = 0;
+	task[i].avgCycles = 0;
+	task[i].maxLateness = 0;
+	task[i].overruns = 0;
+}
+
+void TASK_profile(uint8_t i, uint32_t scheduled, uint32_t start, uint32_t end){
+	uint16_t cycles = TASK_saturate(end - start);
+	uint32_t lateness = start - (scheduled * TASK_CYCLES_PER_TICK);
+	
+	/* a task that removed itself has nothing left to record */
+	if(task[i].taskFunctPtr == 0)
+		return;
+	
+	/* no run takes 0 cycles, so an average of 0 means none has been seen */
+	if(task[i].avgCycles == 0){
+		task[i].avgCycles = cycles;
+	}else{
+		task[i].avgCycles = (uint16_t)((int32_t)task[i].avgCycles
+				+ (((int32_t)cycles - (int32_t)task[i].avgCycles) >> 3));
+	}
+	
+	if(cycles > task[i].maxCycles)
+		task[i].maxCycles = cycles;
+	
+	/* a task can't start before its time, a 'negative' lateness comes from
+	 * the time being read before the tick interrupt was serviced */
+	if(((int32_t)lateness > 0) && (TASK_saturate(lateness) > task[i].maxLateness))
+		task[i].maxLateness = TASK_saturate(lateness);
+	
+	/* the overrun is judged on the full count, not the saturated one */
+	if(((end - start) > (task[i].period * TASK_CYCLES_PER_TICK))
+			&& (task[i].overruns < 0xffff))
+		task[i].overruns++;
+}
+
+uint16_t TASK_saturate(uint32_t value){
+	return (value > 0xffff) ? 0xffff : (uint16_t)value;
+}
+#endif
+
+void TASK_heapSwap(uint8_t i, uint8_t j){
+	uint8_t slot = heap[i];
+	
+	heap[i] = heap[j];
+	heap[j] = slot;
+	
+	task[heap[i]].heapIndex = i;
+	task[heap[j]].heapIndex = j;
+}
+
+void TASK_siftUp(uint8_t i){
+	while(i > 0){
+		uint8_t parent = (i - 1) >> 1;
+		
+		if(TIME_REACHED(task[heap[i]].nextExecutionTime, task[heap[parent]].nextExecutionTime))
+			break;
+		
+		TASK_heapSwap(i, parent);
+		i = parent;
+	}
+}
+
+void TASK_siftDown(uint8_t i){
+	while(1){
+		uint8_t smallest = i;
+		uint8_t child = (i << 1) + 1;
+		
+		if((child < heapLength)
+				&& !TIME_REACHED(task[heap[child]].nextExecutionTime, task[heap[smallest]].nextExecutionTime))
+			smallest = child;
+		
+		child++;
+		if((child < heapLength)
+				&& !TIME_REACHED(task[heap[child]].nextExecutionTime, task[heap[smallest]].nextExecutionTime))
+			smallest = child;
+		
+		if(smallest == i)
+			break;
+		
+		TASK_heapSwap(i, smallest);
+		i = smallest;
+	}
+}
+
+void TASK_heapRemove(uint8_t i){
+	/* fill the hole with the last task and restore the order around it */
+	heapLength--;
+	
+	if(i < heapLength){
+		uint8_t moved = heap[heapLength];
+		
+		TASK_heapSwap(i, heapLength);
+		TASK_siftUp(i);
+		TASK_siftDown(task[moved].heapIndex);
 	}
 }
 
 void TMR_init(void (*functPtr)()){
 	TMR_timedFunctPtr = functPtr;
 
-    /* period registers */
+    /* period registers; the timer counts from 0 to the period inclusive */
     CCP3PRH = 0;
-    CCP3PRL = 12000;
+    CCP3PRL = CLOCK_TICK_CYCLES - 1;
     
     CCP3CON1L = 0x0000; // timer mode
     CCP3CON1H = 0x0000;
@@ -168,6 +513,7 @@ void TMR_init(void (*functPtr)()){
     CCP3CON3L = 0;
     CCP3CON3H = 0x0000;
     
+    IPC6bits.CCT3IP = PRIORITY_CCT3;
     IFS1bits.CCT3IF = 0;
     IEC1bits.CCT3IE = 1;
     
@@ -179,9 +525,19 @@ void TMR_disableInterrupt(){
 }
 
 void _ISR _CCT3Interrupt(){
+    /* the timer count is the time since the period match */
+    ISR_ENTER(ISR_CCT3, CCP3TMRL);
+    TRACE(TRACE_ISR_CCT3, 0);
+    
+    /* the flag is cleared together with the tick being counted so that
+     * a higher priority interrupt reading the timebase never sees one
+     * without the other */
+    __builtin_disi(0x3fff);
+    IFS1bits.CCT3IF = 0;
     if(TMR_timedFunctPtr != 0)
 		(*TMR_timedFunctPtr)();
+    __builtin_disi(0x0000);
     
-    IFS1bits.CCT3IF = 0;
+    ISR_EXIT(ISR_CCT3);
 }
 
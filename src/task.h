@@ -9,13 +9,115 @@
 #define TASK_H_
 
 #include <stdint.h>
+#include "clock.h"
+
+/* the maximum number of tasks that may be added at once: five periodic
+ * tasks, up to three one-shots around a sweep, and room for more; each slot
+ * costs 17 bytes of RAM, 25 in debug builds, left to the stack check at link */
+#define MAX_NUM_OF_TASKS	12
+
+#if (MAX_NUM_OF_TASKS < 1) || (MAX_NUM_OF_TASKS > 255)
+#error "MAX_NUM_OF_TASKS must be between 1 and 255"
+#endif
+
+/* the time taken by each task is measured in debug builds only */
+#ifdef __DEBUG
+#define TASK_PROFILING	1
+#else
+#define TASK_PROFILING	0
+#endif
+
+/* the number of instruction cycles in each 1 ms tick */
+#define TASK_CYCLES_PER_TICK	((uint16_t)CLOCK_TICK_CYCLES)
+
+/* the number of events that may be waiting to be dispatched */
+#define MAX_NUM_OF_EVENTS	8
+
+/* the event ids run from 0 to MAX_NUM_OF_EVENT_TYPES - 1 */
+#define MAX_NUM_OF_EVENT_TYPES	4
+
+#if (MAX_NUM_OF_EVENTS != 2) && \
+    (MAX_NUM_OF_EVENTS != 4) && \
+    (MAX_NUM_OF_EVENTS != 8) && \
+    (MAX_NUM_OF_EVENTS != 16) && \
+    (MAX_NUM_OF_EVENTS != 32) && \
+    (MAX_NUM_OF_EVENTS != 64) && \
+    (MAX_NUM_OF_EVENTS != 128)
+#error "MAX_NUM_OF_EVENTS must be a power of 2, no more than 128"
+#endif
+
+/* identifies a one-shot timer: the generation of the slot in the upper
+ * byte and the slot in the lower byte, so that a handle to a timer that
+ * has already expired never matches a later timer in the same slot */
+typedef uint16_t TaskHandle;
+
+#define TASK_INVALID_HANDLE	0
+
+#if TASK_PROFILING
+/* the execution statistics of a periodic task, all times in cycles; each
+ * saturates at 0xffff (4 ms at 16 MHz), which reads as 'at least' */
+typedef struct {
+	void (*taskFunctPtr)();
+	uint16_t maxCycles;
+	uint16_t avgCycles;		/* moving average over about 8 runs */
+	uint16_t maxLateness;	/* the latest that the task started */
+	uint16_t overruns;		/* runs that took longer than the period */
+}TaskProfile;
+#endif
 
 void TASK_init();
-void TASK_add(void (*functPtr)(), uint32_t period);
+/* resumable tasks: a task that is part way through a long job returns with
+ * TASK_YIELD() and resumes from that point the next time that it executes;
+ * 'state' is a TaskState kept in a static variable, 0 to start.  Local
+ * variables don't survive a yield and switch statements can't span one. */
+typedef uint16_t TaskState;
+
+#define TASK_BEGIN(state)	switch(state){ case 0:
+#define TASK_YIELD(state)	do{ (state) = __LINE__; return; case __LINE__:; }while(0)
+#define TASK_END(state)		} (state) = 0
+
+/* the periods and delays must be less than 2^31 ms; returns 0 when
+ * there is no free task slot */
+uint8_t TASK_add(void (*functPtr)(), uint32_t period);
 void TASK_remove(void (*functPtr)());
+
+/* execute 'functPtr(arg)' once, 'ticks' ms from now; returns
+ * TASK_INVALID_HANDLE when there is no free task slot */
+TaskHandle TASK_after(void (*functPtr)(uint16_t arg), uint32_t ticks, uint16_t arg);
+
+/* cancel a one-shot timer that hasn't yet executed; returns 1
+ * if the timer was cancelled, 0 if it had already executed */
+uint8_t TASK_cancel(TaskHandle handle);
+
+/* set the function that handles an event id, 0 to ignore the event */
+void TASK_onEvent(uint8_t event, void (*functPtr)(uint16_t payload));
+
+/* queue an event to be handled by the main loop ahead of any tasks; safe
+ * to call from any interrupt, returns 0 if the queue was full */
+uint8_t TASK_post(uint8_t event, uint16_t payload);
+
+/* the number of events lost because the queue was full */
+uint16_t TASK_getEventOverflows();
 void TASK_manage();
 
+#if TASK_PROFILING
+/* copies the statistics of the task in 'slot'; returns 0 if
+ * there is no periodic task in that slot */
+uint8_t TASK_getProfile(uint8_t slot, TaskProfile* profile);
+
+/* clears the statistics of all of the tasks */
+void TASK_resetProfiles();
+#endif
+
+/* the time in ms; it wraps, so compare times by the sign of their
+ * difference, i.e. (int32_t)(a - b) >= 0 */
 uint32_t TASK_getTime();
-void TASK_resetTime(uint32_t time);
+
+/* the time in us, wrapping every 71.6 minutes; safe to call from
+ * any interrupt */
+uint32_t TASK_getMicros();
+
+/* the RAM taken by the task table and the event queue, in bytes */
+uint16_t TASK_staticBytes();
 
 #endif /* TASK_H_ */
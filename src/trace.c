@@ -0,0 +1,81 @@
+#include <xc.h>
+#include "trace.h"
+#include "task.h"
+
+volatile uint16_t traceMask = TRACE_DEFAULT_MASK;
+
+static volatile TraceRecord trace[TRACE_LENGTH];
+static volatile uint8_t traceHead = 0;
+static volatile uint8_t frozen = 0;
+static volatile uint32_t lastMicros = 0;
+
+void TRACE_record(TraceId id, uint8_t arg){
+    uint32_t now, delta;
+    uint8_t i;
+    
+    /* the slot and the time are claimed together so that a nested
+     * interrupt never takes the same slot or goes backwards in time */
+    __builtin_disi(0x3fff);
+    if(frozen){
+        __builtin_disi(0x0000);
+        return;
+    }
+    
+    now = TASK_getMicros();
+    delta = now - lastMicros;
+    lastMicros = now;
+    
+    i = traceHead;
+    traceHead = (i + 1) & (TRACE_LENGTH - 1);
+    
+    trace[i].delta = (delta > 0xffff) ? 0xffff : (uint16_t)delta;
+    trace[i].id = (uint8_t)id;
+    trace[i].arg = arg;
+    __builtin_disi(0x0000);
+}
+
+void TRACE_setMask(uint16_t mask){
+    traceMask = mask;
+}
+
+void TRACE_trigger(TraceReason reason){
+    if(frozen)
+        return;
+    
+    TRACE_record(TRACE_TRIGGER, (uint8_t)reason);
+    frozen = 1;
+}
+
+uint8_t TRACE_isFrozen(void){
+    return frozen;
+}
+
+void TRACE_read(uint16_t* dest){
+    uint8_t i, n;
+    
+    /* the head is the oldest record once the trace has wrapped */
+    i = traceHead;
+    for(n = 0; n < TRACE_LENGTH; n++){
+        *dest++ = trace[i].delta;
+        *dest++ = ((uint16_t)trace[i].id << 8) | trace[i].arg;
+        i = (i + 1) & (TRACE_LENGTH - 1);
+    }
+}
+
+void TRACE_resume(void){
+    uint8_t i;
+    
+    for(i = 0; i < TRACE_LENGTH; i++){
+        trace[i].id = TRACE_NONE;
+    }
+    
+    __builtin_disi(0x3fff);
+    traceHead = 0;
+    lastMicros = TASK_getMicros();
+    frozen = 0;
+    __builtin_disi(0x0000);
+}
+
+uint16_t TRACE_staticBytes(void){
+    return sizeof(trace);
+}
@@ -0,0 +1,122 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdint.h>
+
+/* the number of records kept, a power of 2; the oldest are overwritten */
+#define TRACE_LENGTH    16
+
+#if (TRACE_LENGTH != 4) && \
+    (TRACE_LENGTH != 8) && \
+    (TRACE_LENGTH != 16) && \
+    (TRACE_LENGTH != 32) && \
+    (TRACE_LENGTH != 64)
+#error "TRACE_LENGTH must be a power of 2 between 4 and 64"
+#endif
+
+/** The traced events, each recorded with an 8-bit argument */
+typedef enum traceid{
+    TRACE_NONE,         /* an unused record */
+    TRACE_ISR_T1,
+    TRACE_ISR_ADC1,
+    TRACE_ISR_U1TX,
+    TRACE_ISR_U1RX,
+    TRACE_ISR_CCT3,
+    TRACE_TASK,         /* arg: the task slot */
+    TRACE_FRAME_TX,
+    TRACE_FRAME_RX,     /* arg: the message length, up to 255 */
+    TRACE_FRAME_ERROR,
+    TRACE_MODE,         /* arg: the new ViMode, as sent on "status" */
+    TRACE_TRIGGER,      /* arg: the TraceReason */
+    TRACE_NUM_OF_IDS
+}TraceId;
+
+/** The reasons that the trace was frozen */
+typedef enum tracereason{
+    TRACE_REASON_REQUEST,
+    TRACE_REASON_FRAME_ERROR,
+    TRACE_REASON_UART_OVERRUN
+}TraceReason;
+
+/* the interrupts and the 1 ms tasks would fill the trace within a few
+ * ms, so they are only recorded once the host asks for them */
+#define TRACE_DEFAULT_MASK  ((1u << TRACE_FRAME_TX) | \
+                             (1u << TRACE_FRAME_RX) | \
+                             (1u << TRACE_FRAME_ERROR) | \
+                             (1u << TRACE_MODE) | \
+                             (1u << TRACE_TRIGGER))
+
+/**
+ * A trace record, sent to the host as two u16 words:
+ *  - the us since the previous record, saturated at 0xffff
+ *  - the TraceId in the high byte and the argument in the low byte
+ */
+typedef struct{
+    uint16_t delta;
+    uint8_t id;
+    uint8_t arg;
+}TraceRecord;
+
+extern volatile uint16_t traceMask;
+
+/**
+ * Records an event, if it is in the mask; safe to use from any
+ * interrupt or task
+ * 
+ * @param id the TraceId
+ * @param arg the event argument
+ */
+#define TRACE(id, arg)                                          \
+    do{                                                         \
+        if(traceMask & (1u << (id)))                            \
+            TRACE_record((id), (uint8_t)(arg));                 \
+    }while(0)
+
+/**
+ * Records an event regardless of the mask, use TRACE() instead
+ * 
+ * @param id the TraceId
+ * @param arg the event argument
+ */
+void TRACE_record(TraceId id, uint8_t arg);
+
+/**
+ * Sets the events that are recorded
+ * 
+ * @param mask a bit for each TraceId
+ */
+void TRACE_setMask(uint16_t mask);
+
+/**
+ * Records the trigger and freezes the trace so that the events leading up
+ * to it are kept until TRACE_resume() is called; later triggers are
+ * ignored while frozen
+ * 
+ * @param reason the TraceReason
+ */
+void TRACE_trigger(TraceReason reason);
+
+/**
+ * @return 1 if the trace is frozen, else 0
+ */
+uint8_t TRACE_isFrozen(void);
+
+/**
+ * Copies the trace, oldest record first, as two words per record; only
+ * consistent while the trace is frozen
+ * 
+ * @param dest the destination, (TRACE_LENGTH * 2) words
+ */
+void TRACE_read(uint16_t* dest);
+
+/**
+ * Clears the trace and starts recording again
+ */
+void TRACE_resume(void);
+
+/**
+ * @return the RAM taken by the trace, in bytes
+ */
+uint16_t TRACE_staticBytes(void);
+
+#endif
@@ -1,32 +1,63 @@
 #include "uart.h"
 #include "cbuffer.h"
+#include "isrstat.h"
+#include "priority.h"
+#include "trace.h"
+#include "clock.h"
 #include <xc.h>
 
 #define BUF_WIDTH_IN_BITS   8
 
 volatile static Buffer txBuf;
 volatile static Buffer rxBuf;
-volatile static uint8_t txBufArr[TX_BUF_LENGTH];
-volatile static uint8_t rxBufArr[RX_BUF_LENGTH];
 volatile static uint8_t writeLock = 0;
 volatile static uint8_t readLock = 0;
 
+/* the transmit buffer index of the first byte held by UART_holdTx(), or
+ * TX_NOT_HELD; the transmitter stops short of it until it is released.  The
+ * index is taken as the byte is written, once there is space for it, since
+ * the index of the next write is also that of the oldest byte in a full
+ * buffer */
+#define TX_NOT_HELD     0xffff
+volatile static uint16_t txHold = TX_NOT_HELD;
+static uint8_t txHoldNext = 0;
+
+/* credit-based flow control: the number of bytes that may be sent and the
+ * number of bytes granted to the peer but not yet received */
+volatile static uint8_t flowControl = 0;
+volatile static uint16_t txCredits = 0;
+volatile static uint16_t rxCredits = 0;
+volatile static uint8_t txReserveReleased = 0;
+static uint8_t txStalled = 0;
+
+/* set when the peer has spent its whole grant; the peer's queue can't be
+ * seen from here, so that is taken as the sign that it has more to send */
+volatile static uint8_t rxGrantSpent = 0;
+
+volatile static UartStats stats;
+
+static void UART_lockStats(void);
+static void UART_unlockStats(void);
+static uint16_t UART_spareTxCredits(void);
+
 void UART_init(void){
     ANSBbits.ANSB2 = ANSBbits.ANSB7 = 0;
     TRISBbits.TRISB2 = 1;
     TRISBbits.TRISB7 = 0;
     
-    BUF_init((Buffer*)&txBuf, (uint8_t*)txBufArr, TX_BUF_LENGTH, BUF_WIDTH_IN_BITS);
-    BUF_init((Buffer*)&rxBuf, (uint8_t*)rxBufArr, RX_BUF_LENGTH, BUF_WIDTH_IN_BITS);
+    BUF_init((Buffer*)&txBuf, ARENA_region(ARENA_UART_TX), TX_BUF_LENGTH, BUF_WIDTH_IN_BITS);
+    BUF_init((Buffer*)&rxBuf, ARENA_region(ARENA_UART_RX), RX_BUF_LENGTH, BUF_WIDTH_IN_BITS);
     
-    /* baud rate = 57600bps 
-     * U1BRG = (12000000/(16*57600)) - 1 = 12.02 = 12
+    /* baud rate = CLOCK_BAUD_RATE, 57600bps
+     * U1BRG = (F_CY/(4*57600)) - 1, rounded
      */
-    U1BRG = 12;
-    U1MODE = 0x0000;    /* TX/RX only, standard mode */
+    U1BRG = CLOCK_U1BRG;
+    U1MODE = 0x0008;    /* TX/RX only, high speed baud clock */
     U1STA = 0x0000;     /* enable */
     
     /* uart interrupts */
+    IPC2bits.U1RXIP = PRIORITY_U1RX;
+    IPC3bits.U1TXIP = PRIORITY_U1TX;
     IFS0bits.U1TXIF = IFS0bits.U1RXIF = 0;
     IEC0bits.U1TXIE = IEC0bits.U1RXIE = 1;
     
@@ -56,9 +87,27 @@ void UART_write(uint8_t* data, uint16_t length){
     uint32_t i = 0;
     
     while(i < length){
-        while(UART_writeable() == 0);   /* wait for any current writes to clear */
-
-        writeLock = 1;        
+        /* wait for any current writes to clear; the caller has checked
+         * UART_sendable(), so the credits cover every byte in the buffer
+         * and it always drains */
+        if(UART_writeable() == 0){
+            /* the frames are written a byte at a time, so a stall is
+             * counted once until a write finds space without waiting */
+            if(txStalled == 0)
+                stats.txStalls++;
+            
+            txStalled = 1;
+            while(UART_writeable() == 0);
+        }else{
+            txStalled = 0;
+        }
+        
+        writeLock = 1;
+        if(txHoldNext){
+            txHold = BUF_writeIndex((Buffer*)&txBuf);
+            txHoldNext = 0;
+        }
+        
         BUF_write8((Buffer*)&txBuf, data[i]);
         writeLock = 0;
         
@@ -73,6 +122,26 @@ void UART_write(uint8_t* data, uint16_t length){
     }
 }
 
+void UART_holdTx(void){
+    txHoldNext = 1;
+}
+
+void UART_releaseTx(uint8_t data){
+    txHoldNext = 0;
+    if(txHold == TX_NOT_HELD)
+        return;
+    
+    writeLock = 1;
+    BUF_overwrite8((Buffer*)&txBuf, txHold, data);
+    txHold = TX_NOT_HELD;
+    writeLock = 0;
+    
+    /* the transmitter may have stopped at the held byte */
+    if(U1STAbits.UTXBF == 0){
+        IFS0bits.U1TXIF = 1;
+    }
+}
+
 uint16_t UART_readable(void){
     uint16_t readable;
     
@@ -96,32 +165,185 @@ uint16_t UART_writeable(void){
     return writeable;
 }
 
+uint16_t UART_sendable(void){
+    uint16_t spare;
+    
+    if(flowControl == 0)
+        return 0xffff;
+    
+    spare = UART_spareTxCredits();
+    if(txReserveReleased)
+        return spare;
+    
+    return (spare > TX_CREDIT_RESERVE) ? (spare - TX_CREDIT_RESERVE) : 0;
+}
+
+void UART_releaseTxReserve(uint8_t release){
+    txReserveReleased = release;
+}
+
+void UART_addTxCredits(uint16_t credits){
+    writeLock = 1;
+    if(credits > (0xffff - txCredits)){
+        txCredits = 0xffff;
+    }else{
+        txCredits += credits;
+    }
+    flowControl = 1;
+    writeLock = 0;
+    
+    /* restart a transmitter that was waiting for credits */
+    if(U1STAbits.UTXBF == 0){
+        IFS0bits.U1TXIF = 1;
+    }
+}
+
+uint16_t UART_takeRxCredits(void){
+    uint16_t credits = 0;
+    uint16_t empty;
+    
+    if(flowControl == 0)
+        return 0;
+    
+    if(UART_spareTxCredits() < TX_CREDIT_RESERVE)
+        return 0;
+    
+    readLock = 1;
+    empty = (uint16_t)BUF_emptySlots((Buffer*)&rxBuf);
+    if(empty >= (rxCredits + RX_CREDIT_MIN_GRANT)){
+        credits = empty - rxCredits;
+        rxCredits += credits;
+        rxGrantSpent = 0;
+    }
+    readLock = 0;
+    
+    /* if an rx occurred during the readLock, then there is data in the rx
+     * register that is not processed, so kick the interrupt */
+    if(U1STAbits.URXDA)
+        IFS0bits.U1RXIF = 1;
+    
+    return credits;
+}
+
+void UART_flowTick(uint16_t elapsedMs){
+    if(flowControl == 0)
+        return;
+    
+    if((txCredits == 0) && (BUF_status((Buffer*)&txBuf) != BUFFER_EMPTY))
+        stats.txThrottledTime += elapsedMs;
+    
+    if(rxGrantSpent)
+        stats.rxThrottledTime += elapsedMs;
+}
+
+void UART_getStats(UartStats* dest){
+    UART_lockStats();
+    *dest = stats;
+    UART_unlockStats();
+}
+
+void UART_resetStats(void){
+    UART_lockStats();
+    stats.txBytes = stats.rxBytes = 0;
+    stats.txThrottledTime = stats.rxThrottledTime = 0;
+    stats.txStalls = 0;
+    stats.rxOverruns = stats.rxFramingErrors = 0;
+    UART_unlockStats();
+}
+
+uint16_t UART_spareTxCredits(void){
+    uint16_t queued, credits;
+    
+    /* the credits not already owed to the bytes in the buffer; the buffer
+     * is read first, so a byte sent in between only makes this smaller */
+    queued = (uint16_t)BUF_fullSlots((Buffer*)&txBuf);
+    credits = txCredits;
+    
+    return (credits > queued) ? (credits - queued) : 0;
+}
+
+void UART_lockStats(void){
+    /* the interrupts leave the counters alone while locked */
+    readLock = writeLock = 1;
+}
+
+void UART_unlockStats(void){
+    readLock = writeLock = 0;
+    
+    /* kick any interrupts that were held off by the locks */
+    if(U1STAbits.URXDA)
+        IFS0bits.U1RXIF = 1;
+    
+    if(U1STAbits.UTXBF == 0)
+        IFS0bits.U1TXIF = 1;
+}
+
 void _ISR _U1TXInterrupt(void){
+    ISR_ENTER(ISR_U1TX, ISR_NO_LATENCY);
+    TRACE(TRACE_ISR_U1TX, 0);
+    
     if(writeLock == 0){
         /* read the byte(s) to be transmitted from the tx circular
          * buffer and transmit using the hardware register */
         while((BUF_status((Buffer*)&txBuf) != BUFFER_EMPTY)
-                && (U1STAbits.UTXBF == 0)){
+                && (BUF_readIndex((Buffer*)&txBuf) != txHold)
+                && (U1STAbits.UTXBF == 0)
+                && ((flowControl == 0) || (txCredits > 0))){
 
             U1TXREG = BUF_read8((Buffer*)&txBuf);
+            stats.txBytes++;
+            
+            if(flowControl)
+                txCredits--;
         }
     }
     
     IFS0bits.U1TXIF = 0;
+    
+    ISR_EXIT(ISR_U1TX);
 }
 
 void _ISR _U1RXInterrupt(void){
+    ISR_ENTER(ISR_U1RX, ISR_NO_LATENCY);
+    TRACE(TRACE_ISR_U1RX, 0);
+    
     /* read the received byte(s) from the register and write
      * to the rx circular buffer */
     if(readLock == 0){
         while((BUF_status((Buffer*)&rxBuf) != BUFFER_FULL)
                 && (U1STAbits.URXDA)){
+            /* the framing error belongs to the byte at the top of the fifo */
+            if(U1STAbits.FERR)
+                stats.rxFramingErrors++;
+            
             BUF_write8((Buffer*)&rxBuf, U1RXREG);
+            stats.rxBytes++;
+            
+            if(rxCredits > 0){
+                rxCredits--;
+                
+                if(rxCredits == 0)
+                    rxGrantSpent = 1;
+            }
+        }
+        
+        /* an overrun stops the receiver until it is cleared, which also
+         * discards the fifo contents */
+        if(U1STAbits.OERR){
+            stats.rxOverruns++;
+            U1STAbits.OERR = 0;
+            TRACE_trigger(TRACE_REASON_UART_OVERRUN);
         }
     }
     
-    
     IFS0bits.U1RXIF = 0;
+    
+    ISR_EXIT(ISR_U1RX);
 }
 
-
+uint16_t UART_staticBytes(void){
+    return sizeof(txBuf) + sizeof(rxBuf)
+            + ARENA_regionBytes(ARENA_UART_TX)
+            + ARENA_regionBytes(ARENA_UART_RX)
+            + sizeof(stats);
+}
@@ -2,9 +2,29 @@
 #define _UART_H
 
 #include <stdint.h>
+#include "arena.h"
 
-#define TX_BUF_LENGTH       512
-#define RX_BUF_LENGTH       32
+/* TX_BUF_LENGTH and RX_BUF_LENGTH are set by the arena profile */
+
+/* receive credits are only granted once this many bytes are free, so that
+ * the grants don't take up too much of the transmit bandwidth */
+#define RX_CREDIT_MIN_GRANT (RX_BUF_LENGTH / 2)
+
+/* transmit credits held back for the frame that carries a grant, enough for
+ * a fully escaped "credit" frame; the peer must keep a reserve of its own, or
+ * two peers waiting on each other's grants would never send them */
+#define TX_CREDIT_RESERVE   32
+
+/** The link health counters, all running totals */
+typedef struct{
+    uint32_t txBytes;
+    uint32_t rxBytes;
+    uint32_t txThrottledTime;   /* ms spent waiting for transmit credits */
+    uint32_t rxThrottledTime;   /* ms that the peer had spent its grant */
+    uint16_t txStalls;          /* runs of writes that waited for space */
+    uint16_t rxOverruns;        /* hardware receive overruns */
+    uint16_t rxFramingErrors;
+}UartStats;
 
 /**
  * Initializes the UART
@@ -20,13 +40,31 @@ void UART_init(void);
 void UART_read(uint8_t* data, uint16_t length);
 
 /**
- * Writes data to the UART send circular buffer
+ * Writes data to the UART send circular buffer, waiting for space.  Once
+ * flow control is enabled, no more than UART_sendable() bytes may be
+ * written, or the write waits for credits that may never come.
  * 
  * @param data source array pointer of the data to write
  * @param length length of the data to write
  */
 void UART_write(uint8_t* data, uint16_t length);
 
+/**
+ * Holds the next byte written, and every byte after it, in the transmit
+ * buffer until UART_releaseTx(), so that the byte can be filled in once
+ * it is known.  The held bytes take up space in the buffer, so no more
+ * than TX_BUF_LENGTH may be written while held, or the write waits forever.
+ */
+void UART_holdTx(void);
+
+/**
+ * Replaces the first byte held by UART_holdTx() and sends it along with
+ * the bytes written after it; does nothing if no byte is held
+ * 
+ * @param data the value of the held byte
+ */
+void UART_releaseTx(uint8_t data);
+
 /**
  * Returns the number of bytes waiting to be read
  * from the UART circuilar buffer
@@ -41,6 +79,70 @@ uint16_t UART_readable(void);
  */
 uint16_t UART_writeable(void);
 
+/**
+ * Returns the number of bytes that can be written and will be transmitted
+ * on the credits already granted, less TX_CREDIT_RESERVE unless the
+ * reserve is released.  Unlimited until flow control is enabled.
+ * 
+ * @return the number of bytes that may be written
+ */
+uint16_t UART_sendable(void);
+
+/**
+ * Releases the TX_CREDIT_RESERVE to UART_sendable(), for the grant only
+ * 
+ * @param release 1 while the frame carrying a grant is written, else 0
+ */
+void UART_releaseTxReserve(uint8_t release);
+
+/**
+ * Adds to the number of bytes that the peer is able to receive.  The
+ * first call enables credit-based flow control: from then on, bytes are
+ * only transmitted while there are credits and are held in the transmit
+ * buffer otherwise.  Until then, the transmitter is never throttled.
+ * 
+ * @param credits the number of bytes granted by the peer
+ */
+void UART_addTxCredits(uint16_t credits);
+
+/**
+ * Returns the number of bytes that the peer may now be granted, and
+ * counts them as granted.  The grant covers the free space in the receive
+ * buffer that hasn't already been granted, so a peer that sends only what
+ * it has been granted can never overflow the receive buffer.  Returns 0
+ * until flow control has been enabled by UART_addTxCredits(), while the
+ * grant would be smaller than RX_CREDIT_MIN_GRANT, and while the transmit
+ * credits can't cover TX_CREDIT_RESERVE, since a grant that isn't sent
+ * would never reach the peer.
+ * 
+ * @return the number of bytes to grant to the peer
+ */
+uint16_t UART_takeRxCredits(void);
+
+/**
+ * Accumulates the throttled time counters, must be called periodically
+ * 
+ * @param elapsedMs the time since the last call, in ms
+ */
+void UART_flowTick(uint16_t elapsedMs);
+
+/**
+ * Copies the link health counters
+ * 
+ * @param stats the destination for the counters
+ */
+void UART_getStats(UartStats* stats);
+
+/**
+ * @return the RAM taken by the UART module's variables, in bytes
+ */
+uint16_t UART_staticBytes(void);
+
+/**
+ * Clears the link health counters
+ */
+void UART_resetStats(void);
+
 #if (TX_BUF_LENGTH != 2) && \
     (TX_BUF_LENGTH != 4) && \
     (TX_BUF_LENGTH != 8) && \